@@ -244,51 +244,45 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
 {
     TranslationBlock *tb;
     CPUJumpCache *jc;
-    uint32_t hash;
+    CPUJumpCacheEntry *set;
+    unsigned i, ways;
 
     /* we should never be trying to look up an INVALID tb */
     tcg_debug_assert(!(cflags & CF_INVALID));
 
-    hash = tb_jmp_cache_hash_func(pc);
     jc = cpu->tb_jmp_cache;
-
-    if (cflags & CF_PCREL) {
-        /* Use acquire to ensure current load of pc from jc. */
-        tb = qatomic_load_acquire(&jc->array[hash].tb);
-
-        if (likely(tb &&
-                   jc->array[hash].pc == pc &&
-                   tb->cs_base == cs_base &&
-                   tb->flags == flags &&
-                   tb_cflags(tb) == cflags)) {
-            return tb;
-        }
-        tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
-        if (tb == NULL) {
-            return NULL;
+    set = tb_jmp_cache_set(jc, pc);
+    ways = 1u << jc->way_bits;
+
+    for (i = 0; i < ways; i++) {
+        if (cflags & CF_PCREL) {
+            /* Use acquire to ensure current load of pc from jc. */
+            tb = qatomic_load_acquire(&set[i].tb);
+            if (tb && set[i].pc != pc) {
+                continue;
+            }
+        } else {
+            /* Use rcu_read to ensure current load of pc from *tb. */
+            tb = qatomic_rcu_read(&set[i].tb);
+            if (tb && tb->pc != pc) {
+                continue;
+            }
         }
-        jc->array[hash].pc = pc;
-        /* Ensure pc is written first. */
-        qatomic_store_release(&jc->array[hash].tb, tb);
-    } else {
-        /* Use rcu_read to ensure current load of pc from *tb. */
-        tb = qatomic_rcu_read(&jc->array[hash].tb);
-
         if (likely(tb &&
-                   tb->pc == pc &&
                    tb->cs_base == cs_base &&
                    tb->flags == flags &&
                    tb_cflags(tb) == cflags)) {
+            qatomic_set(&jc->hits, jc->hits + 1);
             return tb;
         }
-        tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
-        if (tb == NULL) {
-            return NULL;
-        }
-        /* Use the pc value already stored in tb->pc. */
-        qatomic_set(&jc->array[hash].tb, tb);
     }
 
+    qatomic_set(&jc->misses, jc->misses + 1);
+    tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
+    if (tb == NULL) {
+        return NULL;
+    }
+    tb_jmp_cache_insert(jc, set, pc, tb);
     return tb;
 }
 
@@ -538,6 +532,9 @@ void cpu_exec_step_atomic(CPUState *cpu)
         g_assert(cpu == current_cpu);
         g_assert(!cpu->running);
         cpu->running = true;
+        /* Serialized by the exclusive section. */
+        qatomic_set(&tb_ctx.exclusive_step_count,
+                    tb_ctx.exclusive_step_count + 1);
 
         cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
 
@@ -968,7 +965,6 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
             tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
             if (tb == NULL) {
                 CPUJumpCache *jc;
-                uint32_t h;
 
                 mmap_lock();
                 tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
@@ -978,16 +974,8 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
                  */
-                h = tb_jmp_cache_hash_func(pc);
                 jc = cpu->tb_jmp_cache;
-                if (cflags & CF_PCREL) {
-                    jc->array[h].pc = pc;
-                    /* Ensure pc is written first. */
-                    qatomic_store_release(&jc->array[h].tb, tb);
-                } else {
-                    /* Use the pc value already stored in tb->pc. */
-                    qatomic_set(&jc->array[h].tb, tb);
-                }
+                tb_jmp_cache_insert(jc, tb_jmp_cache_set(jc, pc), pc, tb);
             }
 
 #ifndef CONFIG_USER_ONLY
@@ -1070,6 +1058,18 @@ int cpu_exec(CPUState *cpu)
     return ret;
 }
 
+static CPUJumpCache *tb_jmp_cache_new(void)
+{
+    unsigned way_bits = ctz32(tb_jmp_cache_ways);
+    CPUJumpCache *jc;
+
+    jc = g_malloc0(sizeof(CPUJumpCache) +
+                   (sizeof(CPUJumpCacheEntry) << tb_jmp_cache_bits));
+    jc->set_bits = tb_jmp_cache_bits - way_bits;
+    jc->way_bits = way_bits;
+    return jc;
+}
+
 void tcg_exec_realizefn(CPUState *cpu, Error **errp)
 {
     static bool tcg_target_initialized;
@@ -1080,7 +1080,7 @@ void tcg_exec_realizefn(CPUState *cpu, Error **errp)
         tcg_target_initialized = true;
     }
 
-    cpu->tb_jmp_cache = g_new0(CPUJumpCache, 1);
+    cpu->tb_jmp_cache = tb_jmp_cache_new();
     tlb_init(cpu);
 #ifndef CONFIG_USER_ONLY
     tcg_iommu_init_notifier_list(cpu);
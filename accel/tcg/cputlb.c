@@ -102,14 +102,16 @@ static void tlb_window_reset(CPUTLBDesc *desc, int64_t ns,
 static void tb_jmp_cache_clear_page(CPUState *cpu, target_ulong page_addr)
 {
     CPUJumpCache *jc = cpu->tb_jmp_cache;
-    int i, i0;
+    size_t i, i0, n;
 
     if (unlikely(!jc)) {
         return;
     }
 
-    i0 = tb_jmp_cache_hash_page(page_addr);
-    for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
+    i0 = (size_t)tb_jmp_cache_hash_page(page_addr, jc->set_bits)
+         << jc->way_bits;
+    n = (size_t)tb_jmp_cache_page_sets(jc->set_bits) << jc->way_bits;
+    for (i = 0; i < n; i++) {
         qatomic_set(&jc->array[i0 + i].tb, NULL);
     }
 }
@@ -232,8 +234,7 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
 static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
 {
     desc->n_used_entries = 0;
-    desc->large_page_addr = -1;
-    desc->large_page_mask = -1;
+    memset(desc->large_page, -1, sizeof(desc->large_page));
     desc->vindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
     memset(desc->vtable, -1, sizeof(desc->vtable));
@@ -321,10 +322,11 @@ static void flush_all_helper(CPUState *src, run_on_cpu_func fn,
     }
 }
 
-void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
+void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide,
+                      size_t *pcoalesce)
 {
     CPUState *cpu;
-    size_t full = 0, part = 0, elide = 0;
+    size_t full = 0, part = 0, elide = 0, coalesce = 0;
 
     CPU_FOREACH(cpu) {
         CPUArchState *env = cpu->env_ptr;
@@ -332,10 +334,12 @@ void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
         full += qatomic_read(&env_tlb(env)->c.full_flush_count);
         part += qatomic_read(&env_tlb(env)->c.part_flush_count);
         elide += qatomic_read(&env_tlb(env)->c.elide_flush_count);
+        coalesce += qatomic_read(&env_tlb(env)->c.coalesce_flush_count);
     }
     *pfull = full;
     *ppart = part;
     *pelide = elide;
+    *pcoalesce = coalesce;
 }
 
 static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
@@ -492,19 +496,60 @@ static inline void tlb_flush_vtlb_page_locked(CPUArchState *env, int mmu_idx,
     tlb_flush_vtlb_page_mask_locked(env, mmu_idx, page, -1);
 }
 
+/*
+ * Flush every entry within large page region @i of @midx, and forget
+ * the region.  Called with tlb_c.lock held.
+ */
+static void tlb_flush_large_page_locked(CPUArchState *env, int midx, int i)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+    CPUTLBDescFast *f = &env_tlb(env)->f[midx];
+    target_ulong lp_addr = d->large_page[i].addr;
+    target_ulong lp_mask = d->large_page[i].mask;
+    target_ulong n_pages = (~lp_mask >> TARGET_PAGE_BITS) + 1;
+    size_t n_entries = tlb_n_entries(f);
+
+    tlb_debug("flushing large pages midx %d ("
+              TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
+              midx, lp_addr, lp_mask);
+
+    d->large_page[i].addr = -1;
+    d->large_page[i].mask = -1;
+
+    /* Visit each page of the region, or each entry, whichever is fewer. */
+    if (n_pages < n_entries) {
+        for (target_ulong j = 0; j < n_pages; j++) {
+            target_ulong page = lp_addr + (j << TARGET_PAGE_BITS);
+
+            if (tlb_flush_entry_mask_locked(tlb_entry(env, midx, page),
+                                            lp_addr, lp_mask)) {
+                tlb_n_used_entries_dec(env, midx);
+            }
+        }
+    } else {
+        for (size_t j = 0; j < n_entries; j++) {
+            if (tlb_flush_entry_mask_locked(&f->table[j], lp_addr, lp_mask)) {
+                tlb_n_used_entries_dec(env, midx);
+            }
+        }
+    }
+    tlb_flush_vtlb_page_mask_locked(env, midx, lp_addr, lp_mask);
+}
+
 static void tlb_flush_page_locked(CPUArchState *env, int midx,
                                   target_ulong page)
 {
-    target_ulong lp_addr = env_tlb(env)->d[midx].large_page_addr;
-    target_ulong lp_mask = env_tlb(env)->d[midx].large_page_mask;
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+    bool in_large_page = false;
 
     /* Check if we need to flush due to large pages.  */
-    if ((page & lp_mask) == lp_addr) {
-        tlb_debug("forcing full flush midx %d ("
-                  TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
-                  midx, lp_addr, lp_mask);
-        tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
-    } else {
+    for (int i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        if ((page & d->large_page[i].mask) == d->large_page[i].addr) {
+            tlb_flush_large_page_locked(env, midx, i);
+            in_large_page = true;
+        }
+    }
+    if (!in_large_page) {
         if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
             tlb_n_used_entries_dec(env, midx);
         }
@@ -625,6 +670,10 @@ void tlb_flush_page(CPUState *cpu, target_ulong addr)
     tlb_flush_page_by_mmuidx(cpu, addr, ALL_MMUIDX_BITS);
 }
 
+static void tlb_flush_pending_all(CPUState *src_cpu, target_ulong addr,
+                                  target_ulong len, uint16_t idxmap,
+                                  unsigned bits);
+
 void tlb_flush_page_by_mmuidx_all_cpus(CPUState *src_cpu, target_ulong addr,
                                        uint16_t idxmap)
 {
@@ -633,29 +682,8 @@ void tlb_flush_page_by_mmuidx_all_cpus(CPUState *src_cpu, target_ulong addr,
     /* This should already be page aligned */
     addr &= TARGET_PAGE_MASK;
 
-    /*
-     * Allocate memory to hold addr+idxmap only when needed.
-     * See tlb_flush_page_by_mmuidx for details.
-     */
-    if (idxmap < TARGET_PAGE_SIZE) {
-        flush_all_helper(src_cpu, tlb_flush_page_by_mmuidx_async_1,
-                         RUN_ON_CPU_TARGET_PTR(addr | idxmap));
-    } else {
-        CPUState *dst_cpu;
-
-        /* Allocate a separate data block for each destination cpu.  */
-        CPU_FOREACH(dst_cpu) {
-            if (dst_cpu != src_cpu) {
-                TLBFlushPageByMMUIdxData *d
-                    = g_new(TLBFlushPageByMMUIdxData, 1);
-
-                d->addr = addr;
-                d->idxmap = idxmap;
-                async_run_on_cpu(dst_cpu, tlb_flush_page_by_mmuidx_async_2,
-                                 RUN_ON_CPU_HOST_PTR(d));
-            }
-        }
-    }
+    tlb_flush_pending_all(src_cpu, addr, TARGET_PAGE_SIZE, idxmap,
+                          TARGET_LONG_BITS);
 
     tlb_flush_page_by_mmuidx_async_0(src_cpu, addr, idxmap);
 }
@@ -674,31 +702,19 @@ void tlb_flush_page_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
     /* This should already be page aligned */
     addr &= TARGET_PAGE_MASK;
 
+    tlb_flush_pending_all(src_cpu, addr, TARGET_PAGE_SIZE, idxmap,
+                          TARGET_LONG_BITS);
+
     /*
      * Allocate memory to hold addr+idxmap only when needed.
      * See tlb_flush_page_by_mmuidx for details.
      */
     if (idxmap < TARGET_PAGE_SIZE) {
-        flush_all_helper(src_cpu, tlb_flush_page_by_mmuidx_async_1,
-                         RUN_ON_CPU_TARGET_PTR(addr | idxmap));
         async_safe_run_on_cpu(src_cpu, tlb_flush_page_by_mmuidx_async_1,
                               RUN_ON_CPU_TARGET_PTR(addr | idxmap));
     } else {
-        CPUState *dst_cpu;
-        TLBFlushPageByMMUIdxData *d;
-
-        /* Allocate a separate data block for each destination cpu.  */
-        CPU_FOREACH(dst_cpu) {
-            if (dst_cpu != src_cpu) {
-                d = g_new(TLBFlushPageByMMUIdxData, 1);
-                d->addr = addr;
-                d->idxmap = idxmap;
-                async_run_on_cpu(dst_cpu, tlb_flush_page_by_mmuidx_async_2,
-                                 RUN_ON_CPU_HOST_PTR(d));
-            }
-        }
+        TLBFlushPageByMMUIdxData *d = g_new(TLBFlushPageByMMUIdxData, 1);
 
-        d = g_new(TLBFlushPageByMMUIdxData, 1);
         d->addr = addr;
         d->idxmap = idxmap;
         async_safe_run_on_cpu(src_cpu, tlb_flush_page_by_mmuidx_async_2,
@@ -737,17 +753,15 @@ static void tlb_flush_range_locked(CPUArchState *env, int midx,
         return;
     }
 
-    /*
-     * Check if we need to flush due to large pages.
-     * Because large_page_mask contains all 1's from the msb,
-     * we only need to test the end of the range.
-     */
-    if (((addr + len - 1) & d->large_page_mask) == d->large_page_addr) {
-        tlb_debug("forcing full flush midx %d ("
-                  TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
-                  midx, d->large_page_addr, d->large_page_mask);
-        tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
-        return;
+    /* Check if we need to flush due to large pages.  */
+    for (int i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        target_ulong lp_addr = d->large_page[i].addr;
+        target_ulong lp_mask = d->large_page[i].mask;
+
+        if (lp_mask != (target_ulong)-1 &&
+            addr + len - 1 >= lp_addr && addr <= (lp_addr | ~lp_mask)) {
+            tlb_flush_large_page_locked(env, midx, i);
+        }
     }
 
     for (target_ulong i = 0; i < len; i += TARGET_PAGE_SIZE) {
@@ -791,7 +805,8 @@ static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
      * If the length is larger than the jump cache size, then it will take
      * longer to clear each entry individually than it will to clear it all.
      */
-    if (d.len >= (TARGET_PAGE_SIZE * TB_JMP_CACHE_SIZE)) {
+    if (unlikely(!cpu->tb_jmp_cache) ||
+        d.len / TARGET_PAGE_SIZE >= tb_jmp_cache_entries(cpu->tb_jmp_cache)) {
         tcg_flush_jmp_cache(cpu);
         return;
     }
@@ -815,6 +830,107 @@ static void tlb_flush_range_by_mmuidx_async_1(CPUState *cpu,
     g_free(d);
 }
 
+/* Perform the flushes that other vCPUs have posted to @cpu. */
+static void tlb_flush_pending_async_work(CPUState *cpu, run_on_cpu_data data)
+{
+    CPUTLBCommon *c = &env_tlb((CPUArchState *)cpu->env_ptr)->c;
+    CPUTLBPendingFlush pending[CPU_TLB_PENDING_FLUSHES];
+    uint16_t full;
+    unsigned i, n;
+
+    qemu_spin_lock(&c->lock);
+    full = c->pending_full;
+    n = c->n_pending;
+    memcpy(pending, c->pending, n * sizeof(pending[0]));
+    c->pending_full = 0;
+    c->n_pending = 0;
+    c->pending_queued = false;
+    qemu_spin_unlock(&c->lock);
+
+    if (full) {
+        tlb_flush_by_mmuidx_async_work(cpu, RUN_ON_CPU_HOST_INT(full));
+    }
+    for (i = 0; i < n; i++) {
+        TLBFlushRangeData d = {
+            .addr = pending[i].addr,
+            .len = pending[i].len,
+            .idxmap = pending[i].idxmap & ~full,
+            .bits = pending[i].bits,
+        };
+
+        if (d.idxmap) {
+            tlb_flush_range_by_mmuidx_async_0(cpu, d);
+        }
+    }
+}
+
+/*
+ * Post a flush of [@addr, @addr + @len) to @cpu, comparing @bits of the
+ * address, for @idxmap.  Rather than queueing work for each flush, merge
+ * it with those already pending on @cpu, which are then all performed
+ * by one work item the next time @cpu leaves the execution loop.  When
+ * there are too many distinct ranges, flush those mmu_idx entirely.
+ */
+static void tlb_flush_pending_add(CPUState *cpu, target_ulong addr,
+                                  target_ulong len, uint16_t idxmap,
+                                  unsigned bits)
+{
+    CPUTLBCommon *c = &env_tlb((CPUArchState *)cpu->env_ptr)->c;
+    bool queue;
+    unsigned i;
+
+    qemu_spin_lock(&c->lock);
+    idxmap &= ~c->pending_full;
+    for (i = 0; idxmap && i < c->n_pending; i++) {
+        CPUTLBPendingFlush *p = &c->pending[i];
+
+        if (p->idxmap == idxmap && p->bits == bits &&
+            addr <= p->addr + p->len && p->addr <= addr + len) {
+            target_ulong end = MAX(p->addr + p->len, addr + len);
+
+            p->addr = MIN(p->addr, addr);
+            p->len = end - p->addr;
+            idxmap = 0;
+        }
+    }
+    if (idxmap) {
+        if (c->n_pending < CPU_TLB_PENDING_FLUSHES) {
+            c->pending[c->n_pending++] = (CPUTLBPendingFlush) {
+                .addr = addr, .len = len, .idxmap = idxmap, .bits = bits,
+            };
+        } else {
+            for (i = 0; i < c->n_pending; i++) {
+                idxmap |= c->pending[i].idxmap;
+            }
+            c->pending_full |= idxmap;
+            c->n_pending = 0;
+        }
+    }
+    queue = !c->pending_queued;
+    c->pending_queued = true;
+    if (!queue) {
+        qatomic_set(&c->coalesce_flush_count, c->coalesce_flush_count + 1);
+    }
+    qemu_spin_unlock(&c->lock);
+
+    if (queue) {
+        async_run_on_cpu(cpu, tlb_flush_pending_async_work, RUN_ON_CPU_NULL);
+    }
+}
+
+static void tlb_flush_pending_all(CPUState *src_cpu, target_ulong addr,
+                                  target_ulong len, uint16_t idxmap,
+                                  unsigned bits)
+{
+    CPUState *dst_cpu;
+
+    CPU_FOREACH(dst_cpu) {
+        if (dst_cpu != src_cpu) {
+            tlb_flush_pending_add(dst_cpu, addr, len, idxmap, bits);
+        }
+    }
+}
+
 void tlb_flush_range_by_mmuidx(CPUState *cpu, target_ulong addr,
                                target_ulong len, uint16_t idxmap,
                                unsigned bits)
@@ -862,7 +978,6 @@ void tlb_flush_range_by_mmuidx_all_cpus(CPUState *src_cpu,
                                         uint16_t idxmap, unsigned bits)
 {
     TLBFlushRangeData d;
-    CPUState *dst_cpu;
 
     /*
      * If all bits are significant, and len is small,
@@ -884,15 +999,7 @@ void tlb_flush_range_by_mmuidx_all_cpus(CPUState *src_cpu,
     d.idxmap = idxmap;
     d.bits = bits;
 
-    /* Allocate a separate data block for each destination cpu.  */
-    CPU_FOREACH(dst_cpu) {
-        if (dst_cpu != src_cpu) {
-            TLBFlushRangeData *p = g_memdup(&d, sizeof(d));
-            async_run_on_cpu(dst_cpu,
-                             tlb_flush_range_by_mmuidx_async_1,
-                             RUN_ON_CPU_HOST_PTR(p));
-        }
-    }
+    tlb_flush_pending_all(src_cpu, d.addr, len, idxmap, bits);
 
     tlb_flush_range_by_mmuidx_async_0(src_cpu, d);
 }
@@ -912,7 +1019,6 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
                                                unsigned bits)
 {
     TLBFlushRangeData d, *p;
-    CPUState *dst_cpu;
 
     /*
      * If all bits are significant, and len is small,
@@ -934,14 +1040,7 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
     d.idxmap = idxmap;
     d.bits = bits;
 
-    /* Allocate a separate data block for each destination cpu.  */
-    CPU_FOREACH(dst_cpu) {
-        if (dst_cpu != src_cpu) {
-            p = g_memdup(&d, sizeof(d));
-            async_run_on_cpu(dst_cpu, tlb_flush_range_by_mmuidx_async_1,
-                             RUN_ON_CPU_HOST_PTR(p));
-        }
-    }
+    tlb_flush_pending_all(src_cpu, d.addr, len, idxmap, bits);
 
     p = g_memdup(&d, sizeof(d));
     async_safe_run_on_cpu(src_cpu, tlb_flush_range_by_mmuidx_async_1,
@@ -1086,28 +1185,47 @@ void tlb_set_dirty(CPUState *cpu, target_ulong vaddr)
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 }
 
-/* Our TLB does not support large pages, so remember the area covered by
-   large pages and trigger a full TLB flush if these are invalidated.  */
+/* Our TLB does not support large pages, so remember the areas covered by
+   large pages and flush all of an area if any page in it is invalidated.  */
 static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
                                target_ulong vaddr, target_ulong size)
 {
-    target_ulong lp_addr = env_tlb(env)->d[mmu_idx].large_page_addr;
+    CPUTLBDesc *d = &env_tlb(env)->d[mmu_idx];
     target_ulong lp_mask = ~(size - 1);
+    target_ulong best_mask = 0;
+    int i, best = 0;
+
+    /* Since masks contain all 1's from the msb, a smaller mask is larger. */
+    for (i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        if (d->large_page[i].mask <= lp_mask &&
+            (vaddr & d->large_page[i].mask) == d->large_page[i].addr) {
+            return;
+        }
+    }
+    for (i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        if (d->large_page[i].mask == (target_ulong)-1) {
+            d->large_page[i].addr = vaddr & lp_mask;
+            d->large_page[i].mask = lp_mask;
+            return;
+        }
+    }
 
-    if (lp_addr == (target_ulong)-1) {
-        /* No previous large page.  */
-        lp_addr = vaddr;
-    } else {
-        /* Extend the existing region to include the new page.
-           This is a compromise between unnecessary flushes and
-           the cost of maintaining a full variable size TLB.  */
-        lp_mask &= env_tlb(env)->d[mmu_idx].large_page_mask;
-        while (((lp_addr ^ vaddr) & lp_mask) != 0) {
-            lp_mask <<= 1;
+    /* Extend the region which needs to grow the least to include the
+       new page.  This is a compromise between unnecessary flushes and
+       the cost of maintaining a full variable size TLB.  */
+    for (i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        target_ulong mask = lp_mask & d->large_page[i].mask;
+
+        while (((d->large_page[i].addr ^ vaddr) & mask) != 0) {
+            mask <<= 1;
+        }
+        if (mask > best_mask || i == 0) {
+            best_mask = mask;
+            best = i;
         }
     }
-    env_tlb(env)->d[mmu_idx].large_page_addr = lp_addr & lp_mask;
-    env_tlb(env)->d[mmu_idx].large_page_mask = lp_mask;
+    d->large_page[best].addr &= best_mask;
+    d->large_page[best].mask = best_mask;
 }
 
 /*
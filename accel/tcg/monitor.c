@@ -12,11 +12,15 @@
 #include "qapi/type-helpers.h"
 #include "qapi/qapi-commands-machine.h"
 #include "monitor/monitor.h"
+#include "monitor/hmp.h"
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qerror.h"
 #include "sysemu/cpus.h"
 #include "sysemu/cpu-timers.h"
 #include "sysemu/tcg.h"
 #include "tcg/tcg.h"
 #include "internal.h"
+#include "sampler.h"
 
 
 static void dump_drift_info(GString *buf)
@@ -81,6 +85,60 @@ HumanReadableText *qmp_x_query_opcount(Error **errp)
     return human_readable_text_from_str(buf);
 }
 
+void qmp_x_tcg_sampler_start(bool has_frequency, uint32_t frequency,
+                             Error **errp)
+{
+    if (!tcg_enabled()) {
+        error_setg(errp, "Guest sampling is only available with accel=tcg");
+        return;
+    }
+    if (!has_frequency) {
+        frequency = 99;
+    }
+    if (frequency == 0 || frequency > 10000) {
+        error_setg(errp, "Sampling frequency must be between 1 and 10000 Hz");
+        return;
+    }
+
+    tcg_sampler_start(frequency);
+}
+
+void qmp_x_tcg_sampler_stop(Error **errp)
+{
+    tcg_sampler_stop();
+}
+
+HumanReadableText *qmp_x_query_tcg_samples(Error **errp)
+{
+    g_autoptr(GString) buf = g_string_new("");
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "Guest sampling is only available with accel=tcg");
+        return NULL;
+    }
+
+    tcg_sampler_dump(buf);
+
+    return human_readable_text_from_str(buf);
+}
+
+void hmp_tcg_sampler(Monitor *mon, const QDict *qdict)
+{
+    const char *op = qdict_get_str(qdict, "op");
+    bool has_frequency = qdict_haskey(qdict, "frequency");
+    uint32_t frequency = qdict_get_try_int(qdict, "frequency", 0);
+    Error *err = NULL;
+
+    if (!strcmp(op, "on")) {
+        qmp_x_tcg_sampler_start(has_frequency, frequency, &err);
+    } else if (!strcmp(op, "off")) {
+        qmp_x_tcg_sampler_stop(&err);
+    } else {
+        error_setg(&err, QERR_INVALID_PARAMETER, op);
+    }
+    hmp_handle_error(mon, err);
+}
+
 #ifdef CONFIG_PROFILER
 
 int64_t dev_time;
@@ -116,6 +174,7 @@ static void hmp_tcg_register(void)
 {
     monitor_register_hmp_info_hrt("jit", qmp_x_query_jit);
     monitor_register_hmp_info_hrt("opcount", qmp_x_query_opcount);
+    monitor_register_hmp_info_hrt("tcg-samples", qmp_x_query_tcg_samples);
 }
 
 type_init(hmp_tcg_register);
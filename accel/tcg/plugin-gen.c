@@ -41,6 +41,12 @@
  * optimization to avoid generating redundant operations. For instance, for the
  * second and all subsequent callbacks of an event, we do not need to reload the
  * CPU's index into a TCG temp, since the first callback did it already.
+ *
+ * Inline operations and conditional callbacks do not follow this scheme:
+ * their shape depends on the operation and on whether they target a
+ * per-vCPU scoreboard, so the empty event is just a pair of markers and
+ * the ops are generated directly with the usual tcg_gen_FOO helpers
+ * before being moved into place.
  */
 #include "qemu/osdep.h"
 #include "cpu.h"
@@ -83,6 +89,7 @@ enum plugin_gen_cb {
     PLUGIN_GEN_CB_MEM,
     PLUGIN_GEN_ENABLE_MEM_HELPER,
     PLUGIN_GEN_DISABLE_MEM_HELPER,
+    PLUGIN_GEN_MEM_TRACE_RESERVE,
     PLUGIN_GEN_N_CBS,
 };
 
@@ -98,6 +105,11 @@ void HELPER(plugin_vcpu_mem_cb)(unsigned int vcpu_index,
                                 void *userdata)
 { }
 
+void HELPER(plugin_mem_trace_flush)(void *cpu)
+{
+    qemu_plugin_vcpu_mem_trace_flush(cpu);
+}
+
 static void gen_empty_udata_cb(void)
 {
     TCGv_i32 cpu_index = tcg_temp_ebb_new_i32();
@@ -113,21 +125,16 @@ static void gen_empty_udata_cb(void)
 }
 
 /*
- * For now we only support addi_i64.
- * When we support more ops, we can generate one empty inline cb for each.
+ * Inline ops are generated at injection time (see inject_inline_cb), so
+ * there is nothing to emit here besides the markers.
  */
 static void gen_empty_inline_cb(void)
 {
-    TCGv_i64 val = tcg_temp_ebb_new_i64();
-    TCGv_ptr ptr = tcg_temp_ebb_new_ptr();
+}
 
-    tcg_gen_movi_ptr(ptr, 0);
-    tcg_gen_ld_i64(val, ptr, 0);
-    /* pass an immediate != 0 so that it doesn't get optimized away */
-    tcg_gen_addi_i64(val, val, 0xdeadface);
-    tcg_gen_st_i64(val, ptr, 0);
-    tcg_temp_free_ptr(ptr);
-    tcg_temp_free_i64(val);
+/* Likewise, the check depends on the accesses of the following insns */
+static void gen_empty_mem_trace_reserve(void)
+{
 }
 
 static void gen_empty_mem_cb(TCGv_i64 addr, uint32_t info)
@@ -200,10 +207,58 @@ static void plugin_gen_empty_callback(enum plugin_gen_from from)
     }
 }
 
+static void gen_load_mem_trace(TCGv_ptr buf)
+{
+    tcg_gen_ld_ptr(buf, cpu_env, offsetof(CPUState, plugin_mem_trace) -
+                                 offsetof(ArchCPU, env));
+}
+
+/*
+ * Append a record to the vCPU's trace buffer. This is emitted right
+ * after the guest access, where temps of the surrounding expansion
+ * may still be live, so it must not branch: the buffer is a ring and
+ * space is reserved at instruction boundaries, see
+ * inject_mem_trace_reserve().
+ */
+static void gen_mem_trace_record(TCGv_i64 addr, uint32_t info, uint64_t pc)
+{
+    TCGv_ptr buf = tcg_temp_ebb_new_ptr();
+    TCGv_ptr rec = tcg_temp_ebb_new_ptr();
+    TCGv_i32 head = tcg_temp_ebb_new_i32();
+    TCGv_i32 slot = tcg_temp_ebb_new_i32();
+    intptr_t ofs = offsetof(struct qemu_plugin_mem_trace, records);
+
+    gen_load_mem_trace(buf);
+    tcg_gen_ld_i32(head, buf, offsetof(struct qemu_plugin_mem_trace, head));
+    tcg_gen_andi_i32(slot, head, PLUGIN_MEM_TRACE_ENTRIES - 1);
+    tcg_gen_muli_i32(slot, slot, sizeof(struct qemu_plugin_mem_record));
+    tcg_gen_ext_i32_ptr(rec, slot);
+    tcg_gen_add_ptr(rec, rec, buf);
+
+    tcg_gen_st_i64(addr, rec,
+                   ofs + offsetof(struct qemu_plugin_mem_record, vaddr));
+    tcg_gen_st_i64(tcg_constant_i64(pc), rec,
+                   ofs + offsetof(struct qemu_plugin_mem_record, pc));
+    tcg_gen_st_i32(tcg_constant_i32(info), rec,
+                   ofs + offsetof(struct qemu_plugin_mem_record, info));
+
+    tcg_gen_addi_i32(head, head, 1);
+    tcg_gen_st_i32(head, buf, offsetof(struct qemu_plugin_mem_trace, head));
+
+    tcg_temp_free_i32(slot);
+    tcg_temp_free_i32(head);
+    tcg_temp_free_ptr(rec);
+    tcg_temp_free_ptr(buf);
+}
+
 void plugin_gen_empty_mem_callback(TCGv_i64 addr, uint32_t info)
 {
     enum qemu_plugin_mem_rw rw = get_plugin_meminfo_rw(info);
 
+    if (tcg_ctx->plugin_tb->mem_trace) {
+        gen_mem_trace_record(addr, info, tcg_ctx->plugin_insn->vaddr);
+    }
+
     gen_plugin_cb_start(PLUGIN_GEN_FROM_MEM, PLUGIN_GEN_CB_MEM, rw);
     gen_empty_mem_cb(addr, info);
     tcg_gen_plugin_cb_end();
@@ -274,19 +329,6 @@ static TCGOp *copy_const_ptr(TCGOp **begin_op, TCGOp *op, void *ptr)
     return op;
 }
 
-static TCGOp *copy_ld_i64(TCGOp **begin_op, TCGOp *op)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* 2x ld_i32 */
-        op = copy_op(begin_op, op, INDEX_op_ld_i32);
-        op = copy_op(begin_op, op, INDEX_op_ld_i32);
-    } else {
-        /* ld_i64 */
-        op = copy_op(begin_op, op, INDEX_op_ld_i64);
-    }
-    return op;
-}
-
 static TCGOp *copy_st_i64(TCGOp **begin_op, TCGOp *op)
 {
     if (TCG_TARGET_REG_BITS == 32) {
@@ -300,21 +342,6 @@ static TCGOp *copy_st_i64(TCGOp **begin_op, TCGOp *op)
     return op;
 }
 
-static TCGOp *copy_add_i64(TCGOp **begin_op, TCGOp *op, uint64_t v)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* all 32-bit backends must implement add2_i32 */
-        g_assert(TCG_TARGET_HAS_add2_i32);
-        op = copy_op(begin_op, op, INDEX_op_add2_i32);
-        op->args[4] = tcgv_i32_arg(tcg_constant_i32(v));
-        op->args[5] = tcgv_i32_arg(tcg_constant_i32(v >> 32));
-    } else {
-        op = copy_op(begin_op, op, INDEX_op_add_i64);
-        op->args[2] = tcgv_i64_arg(tcg_constant_i64(v));
-    }
-    return op;
-}
-
 static TCGOp *copy_st_ptr(TCGOp **begin_op, TCGOp *op)
 {
     if (UINTPTR_MAX == UINT32_MAX) {
@@ -378,25 +405,6 @@ static TCGOp *append_udata_cb(const struct qemu_plugin_dyn_cb *cb,
     return op;
 }
 
-static TCGOp *append_inline_cb(const struct qemu_plugin_dyn_cb *cb,
-                               TCGOp *begin_op, TCGOp *op,
-                               int *unused)
-{
-    /* const_ptr */
-    op = copy_const_ptr(&begin_op, op, cb->userp);
-
-    /* ld_i64 */
-    op = copy_ld_i64(&begin_op, op);
-
-    /* add_i64 */
-    op = copy_add_i64(&begin_op, op, cb->inline_insn.imm);
-
-    /* st_i64 */
-    op = copy_st_i64(&begin_op, op);
-
-    return op;
-}
-
 static TCGOp *append_mem_cb(const struct qemu_plugin_dyn_cb *cb,
                             TCGOp *begin_op, TCGOp *op, int *cb_idx)
 {
@@ -479,10 +487,278 @@ inject_udata_cb(const GArray *cbs, TCGOp *begin_op)
     inject_cb_type(cbs, begin_op, append_udata_cb, op_ok);
 }
 
+/*
+ * Set @ptr so that @ptr + the returned offset addresses the uint64_t
+ * an inline op works on: either the fixed location @userp, or this
+ * vCPU's element of @entry. The scoreboard array may be reallocated
+ * when vCPUs are added, so its base is loaded at run time.
+ */
+static intptr_t gen_plugin_u64_ptr(TCGv_ptr ptr, qemu_plugin_u64 entry,
+                                   void *userp)
+{
+    GArray *arr;
+    TCGv_i32 cpu_index;
+    TCGv_ptr base;
+
+    if (!entry.score) {
+        tcg_gen_movi_ptr(ptr, (uintptr_t)userp);
+        return 0;
+    }
+
+    arr = entry.score->data;
+    cpu_index = tcg_temp_ebb_new_i32();
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    tcg_gen_muli_i32(cpu_index, cpu_index, g_array_get_element_size(arr));
+    tcg_gen_ext_i32_ptr(ptr, cpu_index);
+    tcg_temp_free_i32(cpu_index);
+
+    base = tcg_temp_ebb_new_ptr();
+    tcg_gen_ld_ptr(base, tcg_constant_ptr(arr), offsetof(GArray, data));
+    tcg_gen_add_ptr(ptr, ptr, base);
+    tcg_temp_free_ptr(base);
+
+    return entry.offset;
+}
+
+static void gen_inline_op(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGv_ptr ptr = tcg_temp_ebb_new_ptr();
+    TCGv_i64 val;
+    intptr_t ofs;
+
+    ofs = gen_plugin_u64_ptr(ptr, cb->inline_insn.entry, cb->userp);
+
+    switch (cb->inline_insn.op) {
+    case QEMU_PLUGIN_INLINE_ADD_U64:
+        val = tcg_temp_ebb_new_i64();
+        tcg_gen_ld_i64(val, ptr, ofs);
+        tcg_gen_addi_i64(val, val, cb->inline_insn.imm);
+        tcg_gen_st_i64(val, ptr, ofs);
+        tcg_temp_free_i64(val);
+        break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        tcg_gen_st_i64(tcg_constant_i64(cb->inline_insn.imm), ptr, ofs);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    tcg_temp_free_ptr(ptr);
+}
+
+static TCGCond plugin_cond_to_tcgcond(enum qemu_plugin_cond cond)
+{
+    switch (cond) {
+    case QEMU_PLUGIN_COND_EQ:
+        return TCG_COND_EQ;
+    case QEMU_PLUGIN_COND_NE:
+        return TCG_COND_NE;
+    case QEMU_PLUGIN_COND_LT:
+        return TCG_COND_LTU;
+    case QEMU_PLUGIN_COND_LE:
+        return TCG_COND_LEU;
+    case QEMU_PLUGIN_COND_GT:
+        return TCG_COND_GTU;
+    case QEMU_PLUGIN_COND_GE:
+        return TCG_COND_GEU;
+    default:
+        /* ALWAYS and NEVER are resolved at registration time */
+        g_assert_not_reached();
+    }
+}
+
+static void gen_inline_cond_cb(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGLabel *skip = gen_new_label();
+    TCGv_ptr ptr = tcg_temp_ebb_new_ptr();
+    TCGv_i64 val = tcg_temp_ebb_new_i64();
+    TCGv_i32 cpu_index;
+    TCGv_ptr udata;
+    TCGOp *op;
+    intptr_t ofs;
+
+    ofs = gen_plugin_u64_ptr(ptr, cb->cond.entry, NULL);
+    tcg_gen_ld_i64(val, ptr, ofs);
+    tcg_gen_brcondi_i64(tcg_invert_cond(plugin_cond_to_tcgcond(cb->cond.cond)),
+                        val, cb->cond.imm, skip);
+    tcg_temp_free_i64(val);
+    tcg_temp_free_ptr(ptr);
+
+    cpu_index = tcg_temp_ebb_new_i32();
+    udata = tcg_temp_ebb_new_ptr();
+    tcg_gen_movi_ptr(udata, (uintptr_t)cb->userp);
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    gen_helper_plugin_vcpu_udata_cb(cpu_index, udata);
+
+    /* point the call at the plugin's callback, as copy_call() does */
+    op = tcg_last_op();
+    tcg_debug_assert(op->opc == INDEX_op_call);
+    op->args[TCGOP_CALLO(op) + TCGOP_CALLI(op)] = (uintptr_t)cb->f.vcpu_udata;
+
+    tcg_temp_free_ptr(udata);
+    tcg_temp_free_i32(cpu_index);
+
+    gen_set_label(skip);
+}
+
+/*
+ * Move the ops emitted after @last_op, which must currently end the
+ * op list, so that they follow @op instead.
+ */
+static void move_ops_after(TCGOp *last_op, TCGOp *op)
+{
+    while (QTAILQ_NEXT(last_op, link)) {
+        TCGOp *new_op = QTAILQ_NEXT(last_op, link);
+
+        QTAILQ_REMOVE(&tcg_ctx->ops, new_op, link);
+        QTAILQ_INSERT_AFTER(&tcg_ctx->ops, op, new_op, link);
+        op = new_op;
+    }
+}
+
 static void
-inject_inline_cb(const GArray *cbs, TCGOp *begin_op, op_ok_fn ok)
+inject_inline_cb(const GArray *cbs, const GArray *cond_cbs,
+                 TCGOp *begin_op, op_ok_fn ok)
+{
+    TCGOp *end_op;
+    TCGOp *last_op;
+    TCGOp *op;
+    int i;
+
+    if ((!cbs || cbs->len == 0) && (!cond_cbs || cond_cbs->len == 0)) {
+        rm_ops(begin_op);
+        return;
+    }
+
+    end_op = find_op(begin_op, INDEX_op_plugin_cb_end);
+    tcg_debug_assert(end_op);
+
+    /* emit the new ops at the end of the TB ... */
+    last_op = tcg_last_op();
+    tcg_debug_assert(last_op != end_op);
+
+    for (i = 0; cbs && i < cbs->len; i++) {
+        struct qemu_plugin_dyn_cb *cb =
+            &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+
+        if (!ok(begin_op, cb)) {
+            continue;
+        }
+        gen_inline_op(cb);
+    }
+    for (i = 0; cond_cbs && i < cond_cbs->len; i++) {
+        gen_inline_cond_cb(&g_array_index(cond_cbs,
+                                          struct qemu_plugin_dyn_cb, i));
+    }
+
+    /* ... and then move them in place of the empty callback */
+    move_ops_after(last_op, end_op);
+    rm_ops_range(begin_op, end_op);
+}
+
+/*
+ * Make sure the trace buffer can take @n more records without wrapping.
+ * The appends themselves are unconditional, so flush up front if there
+ * is not enough room.
+ */
+static void gen_mem_trace_reserve(uint32_t n)
+{
+    TCGLabel *skip = gen_new_label();
+    TCGv_ptr buf = tcg_temp_ebb_new_ptr();
+    TCGv_i32 used = tcg_temp_ebb_new_i32();
+    TCGv_i32 tail = tcg_temp_ebb_new_i32();
+    TCGv_ptr cpu;
+
+    gen_load_mem_trace(buf);
+    tcg_gen_ld_i32(used, buf, offsetof(struct qemu_plugin_mem_trace, head));
+    tcg_gen_ld_i32(tail, buf, offsetof(struct qemu_plugin_mem_trace, tail));
+    tcg_gen_sub_i32(used, used, tail);
+    tcg_gen_brcondi_i32(TCG_COND_LEU, used, PLUGIN_MEM_TRACE_ENTRIES - n, skip);
+    tcg_temp_free_i32(tail);
+    tcg_temp_free_i32(used);
+    tcg_temp_free_ptr(buf);
+
+    cpu = tcg_temp_ebb_new_ptr();
+    tcg_gen_addi_ptr(cpu, cpu_env, -offsetof(ArchCPU, env));
+    gen_helper_plugin_mem_trace_flush(cpu);
+    tcg_temp_free_ptr(cpu);
+
+    gen_set_label(skip);
+}
+
+static bool op_is_mem_trace_reserve(const TCGOp *op)
+{
+    return op->opc == INDEX_op_plugin_cb_start &&
+           op->args[0] == PLUGIN_GEN_FROM_INSN &&
+           op->args[1] == PLUGIN_GEN_MEM_TRACE_RESERVE;
+}
+
+static bool op_is_mem_trace_record(const TCGOp *op)
 {
-    inject_cb_type(cbs, begin_op, append_inline_cb, ok);
+    return op->opc == INDEX_op_plugin_cb_start &&
+           op->args[0] == PLUGIN_GEN_FROM_MEM &&
+           op->args[1] == PLUGIN_GEN_CB_MEM;
+}
+
+/*
+ * Count the records appended by the insn that starts at @end_op, and by
+ * that insn plus as many of the following ones as fit in a reservation.
+ */
+static void count_mem_trace_records(TCGOp *end_op, uint32_t *insn,
+                                    uint32_t *group)
+{
+    uint32_t n = 0, total = 0;
+    bool first = true;
+    TCGOp *op = end_op;
+
+    for (;;) {
+        op = QTAILQ_NEXT(op, link);
+        if (op == NULL || op_is_mem_trace_reserve(op)) {
+            if (first) {
+                *insn = n;
+                first = false;
+            } else if (total + n > PLUGIN_MEM_TRACE_RESERVE) {
+                break;
+            }
+            total += n;
+            n = 0;
+            if (op == NULL) {
+                break;
+            }
+        } else if (op_is_mem_trace_record(op)) {
+            n++;
+        }
+    }
+    *group = MIN(total, PLUGIN_MEM_TRACE_RESERVE);
+}
+
+/*
+ * The TB may append more records than the buffer holds, so the space
+ * check is split: whenever the next insn does not fit in what was
+ * reserved so far, reserve for it and the insns that follow, up to
+ * PLUGIN_MEM_TRACE_RESERVE records.  In the common case this is a
+ * single check at the first insn that accesses memory.
+ */
+static void inject_mem_trace_reserve(struct qemu_plugin_tb *ptb,
+                                     TCGOp *begin_op)
+{
+    TCGOp *end_op = find_op(begin_op, INDEX_op_plugin_cb_end);
+    TCGOp *last_op;
+    uint32_t n, group;
+
+    tcg_debug_assert(end_op);
+
+    count_mem_trace_records(end_op, &n, &group);
+    if (n > ptb->mem_trace_room) {
+        last_op = tcg_last_op();
+        tcg_debug_assert(last_op != end_op);
+        gen_mem_trace_reserve(group);
+        move_ops_after(last_op, end_op);
+        ptb->mem_trace_room = group;
+    }
+    ptb->mem_trace_room -= MIN(n, ptb->mem_trace_room);
+    rm_ops_range(begin_op, end_op);
 }
 
 static void
@@ -538,13 +814,29 @@ static void inject_mem_enable_helper(struct qemu_plugin_tb *ptb,
         n_cbs += cbs[i]->len;
     }
 
-    plugin_insn->mem_helper = plugin_insn->calls_helpers && n_cbs;
+    /* with a trace, the (possibly empty) array just enables the tracing */
+    plugin_insn->mem_helper = plugin_insn->calls_helpers &&
+                              (n_cbs || ptb->mem_trace);
     if (likely(!plugin_insn->mem_helper)) {
         rm_ops(begin_op);
         return;
     }
     ptb->mem_helper = true;
 
+    if (ptb->mem_trace) {
+        /* tell qemu_plugin_vcpu_mem_cb which instruction it is tracing */
+        TCGOp *end_op = find_op(begin_op, INDEX_op_plugin_cb_end);
+        TCGOp *last_op = tcg_last_op();
+        TCGv_ptr buf = tcg_temp_ebb_new_ptr();
+
+        tcg_debug_assert(end_op && last_op != end_op);
+        gen_load_mem_trace(buf);
+        tcg_gen_st_i64(tcg_constant_i64(plugin_insn->vaddr), buf,
+                       offsetof(struct qemu_plugin_mem_trace, pc));
+        tcg_temp_free_ptr(buf);
+        move_ops_after(last_op, end_op);
+    }
+
     arr = g_array_sized_new(false, false,
                             sizeof(struct qemu_plugin_dyn_cb), n_cbs);
 
@@ -594,7 +886,8 @@ static void plugin_gen_tb_udata(const struct qemu_plugin_tb *ptb,
 static void plugin_gen_tb_inline(const struct qemu_plugin_tb *ptb,
                                  TCGOp *begin_op)
 {
-    inject_inline_cb(ptb->cbs[PLUGIN_CB_INLINE], begin_op, op_ok);
+    inject_inline_cb(ptb->cbs[PLUGIN_CB_INLINE], ptb->cbs[PLUGIN_CB_COND],
+                     begin_op, op_ok);
 }
 
 static void plugin_gen_insn_udata(const struct qemu_plugin_tb *ptb,
@@ -610,6 +903,7 @@ static void plugin_gen_insn_inline(const struct qemu_plugin_tb *ptb,
 {
     struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
     inject_inline_cb(insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_INLINE],
+                     insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_COND],
                      begin_op, op_ok);
 }
 
@@ -627,7 +921,7 @@ static void plugin_gen_mem_inline(const struct qemu_plugin_tb *ptb,
     struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
 
     cbs = insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_INLINE];
-    inject_inline_cb(cbs, begin_op, op_rw);
+    inject_inline_cb(cbs, NULL, begin_op, op_rw);
 }
 
 static void plugin_gen_enable_mem_helper(struct qemu_plugin_tb *ptb,
@@ -688,6 +982,9 @@ static void pr_ops(void)
             case PLUGIN_GEN_DISABLE_MEM_HELPER:
                 type = "disable mem helper";
                 break;
+            case PLUGIN_GEN_MEM_TRACE_RESERVE:
+                type = "mem trace reserve";
+                break;
             default:
                 break;
             }
@@ -746,6 +1043,9 @@ static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
                 case PLUGIN_GEN_ENABLE_MEM_HELPER:
                     plugin_gen_enable_mem_helper(plugin_tb, op, insn_idx);
                     break;
+                case PLUGIN_GEN_MEM_TRACE_RESERVE:
+                    inject_mem_trace_reserve(plugin_tb, op);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -799,7 +1099,8 @@ bool plugin_gen_tb_start(CPUState *cpu, const DisasContextBase *db,
 {
     bool ret = false;
 
-    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask)) {
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask) ||
+        test_bit(QEMU_PLUGIN_EV_VCPU_MEM_TRACE, cpu->plugin_mask)) {
         struct qemu_plugin_tb *ptb = tcg_ctx->plugin_tb;
         int i;
 
@@ -819,6 +1120,9 @@ bool plugin_gen_tb_start(CPUState *cpu, const DisasContextBase *db,
         ptb->haddr2 = NULL;
         ptb->mem_only = mem_only;
         ptb->mem_helper = false;
+        ptb->mem_trace = test_bit(QEMU_PLUGIN_EV_VCPU_MEM_TRACE,
+                                  cpu->plugin_mask);
+        ptb->mem_trace_room = 0;
 
         plugin_gen_empty_callback(PLUGIN_GEN_FROM_TB);
     }
@@ -836,6 +1140,10 @@ void plugin_gen_insn_start(CPUState *cpu, const DisasContextBase *db)
     pinsn = qemu_plugin_tb_insn_get(ptb, db->pc_next);
     tcg_ctx->plugin_insn = pinsn;
     plugin_gen_empty_callback(PLUGIN_GEN_FROM_INSN);
+    if (ptb->mem_trace) {
+        gen_wrapped(PLUGIN_GEN_FROM_INSN, PLUGIN_GEN_MEM_TRACE_RESERVE,
+                    gen_empty_mem_trace_reserve);
+    }
 
     /*
      * Detect page crossing to get the new host address.
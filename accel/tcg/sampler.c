@@ -0,0 +1,196 @@
+/*
+ * Sampling profiler for guest code.
+ *
+ * A host timer periodically asks each vCPU to record its guest program
+ * counter.  The request is queued as vCPU work, which kicks the vCPU out
+ * of the execution loop at the next TB boundary, where the CPU state is
+ * up to date.  Samples are aggregated per vCPU and guest PC, and dumped
+ * by symbol in the folded stack format understood by flamegraph.pl and
+ * pprof.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "qemu/main-loop.h"
+#include "hw/core/cpu.h"
+#include "disas/disas.h"
+#include "sampler.h"
+
+typedef struct SamplerCPU {
+    /* guest pc -> number of samples */
+    GHashTable *pcs;
+    uint64_t idle;
+    /* a sample has been requested and not yet taken */
+    bool pending;
+} SamplerCPU;
+
+static struct {
+    QemuMutex lock;
+    QEMUTimer *timer;
+    int64_t period_ns;
+    /* indexed by cpu_index, grown as needed */
+    GPtrArray *cpus;
+} sampler;
+
+static SamplerCPU *sampler_cpu(CPUState *cpu)
+{
+    SamplerCPU *s;
+
+    if (cpu->cpu_index >= (int)sampler.cpus->len) {
+        g_ptr_array_set_size(sampler.cpus, cpu->cpu_index + 1);
+    }
+    s = g_ptr_array_index(sampler.cpus, cpu->cpu_index);
+    if (s == NULL) {
+        s = g_new0(SamplerCPU, 1);
+        s->pcs = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                       NULL, g_free);
+        g_ptr_array_index(sampler.cpus, cpu->cpu_index) = s;
+    }
+    return s;
+}
+
+static void sampler_cpu_free(gpointer p)
+{
+    SamplerCPU *s = p;
+
+    if (s) {
+        g_hash_table_destroy(s->pcs);
+        g_free(s);
+    }
+}
+
+/* Runs on the vCPU thread, outside of the execution loop. */
+static void sampler_take_sample(CPUState *cpu, run_on_cpu_data data)
+{
+    CPUClass *cc = CPU_GET_CLASS(cpu);
+    SamplerCPU *s;
+
+    qemu_mutex_lock(&sampler.lock);
+    s = sampler_cpu(cpu);
+    s->pending = false;
+    if (cpu->halted || !cc->get_pc) {
+        s->idle++;
+    } else {
+        uint64_t pc = cc->get_pc(cpu);
+        gpointer key = &pc;
+        uint64_t *count = g_hash_table_lookup(s->pcs, key);
+
+        if (count == NULL) {
+            /* The key is the first element of the value. */
+            count = g_new0(uint64_t, 2);
+            count[0] = pc;
+            g_hash_table_insert(s->pcs, count, count);
+        }
+        count[1]++;
+    }
+    qemu_mutex_unlock(&sampler.lock);
+}
+
+static void sampler_tick(void *opaque)
+{
+    CPUState *cpu;
+
+    qemu_mutex_lock(&sampler.lock);
+    CPU_FOREACH(cpu) {
+        SamplerCPU *s = sampler_cpu(cpu);
+
+        /* Do not pile up requests on a vCPU that has not run them yet. */
+        if (!s->pending) {
+            s->pending = true;
+            async_run_on_cpu(cpu, sampler_take_sample, RUN_ON_CPU_NULL);
+        }
+    }
+    qemu_mutex_unlock(&sampler.lock);
+
+    timer_mod(sampler.timer,
+              qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + sampler.period_ns);
+}
+
+void tcg_sampler_start(uint32_t frequency)
+{
+    g_assert(qemu_mutex_iothread_locked());
+
+    if (sampler.timer == NULL) {
+        qemu_mutex_init(&sampler.lock);
+        sampler.cpus = g_ptr_array_new_with_free_func(sampler_cpu_free);
+        sampler.timer = timer_new_ns(QEMU_CLOCK_REALTIME, sampler_tick, NULL);
+    }
+
+    qemu_mutex_lock(&sampler.lock);
+    /* Drop old counts; samples still queued on a vCPU stay pending. */
+    for (guint i = 0; i < sampler.cpus->len; i++) {
+        SamplerCPU *s = g_ptr_array_index(sampler.cpus, i);
+
+        if (s) {
+            g_hash_table_remove_all(s->pcs);
+            s->idle = 0;
+        }
+    }
+    sampler.period_ns = NANOSECONDS_PER_SECOND / MAX(frequency, 1);
+    qemu_mutex_unlock(&sampler.lock);
+
+    timer_mod(sampler.timer,
+              qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + sampler.period_ns);
+}
+
+void tcg_sampler_stop(void)
+{
+    g_assert(qemu_mutex_iothread_locked());
+
+    if (sampler.timer) {
+        timer_del(sampler.timer);
+    }
+}
+
+static void sampler_add_symbol(gpointer key, gpointer value, gpointer data)
+{
+    const uint64_t *count = value;
+    GHashTable *symbols = data;
+    const char *sym = lookup_symbol(count[0]);
+    g_autofree char *name = NULL;
+    uint64_t *total;
+
+    name = sym[0] ? g_strdup(sym) : g_strdup_printf("0x%" PRIx64, count[0]);
+    total = g_hash_table_lookup(symbols, name);
+    if (total == NULL) {
+        total = g_new0(uint64_t, 1);
+        g_hash_table_insert(symbols, g_steal_pointer(&name), total);
+    }
+    *total += count[1];
+}
+
+void tcg_sampler_dump(GString *buf)
+{
+    if (sampler.timer == NULL) {
+        return;
+    }
+
+    qemu_mutex_lock(&sampler.lock);
+    for (guint i = 0; i < sampler.cpus->len; i++) {
+        SamplerCPU *s = g_ptr_array_index(sampler.cpus, i);
+        g_autoptr(GHashTable) symbols = NULL;
+        GHashTableIter iter;
+        gpointer name, total;
+
+        if (s == NULL) {
+            continue;
+        }
+        symbols = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        g_free, g_free);
+        g_hash_table_foreach(s->pcs, sampler_add_symbol, symbols);
+
+        g_hash_table_iter_init(&iter, symbols);
+        while (g_hash_table_iter_next(&iter, &name, &total)) {
+            g_string_append_printf(buf, "cpu%u;%s %" PRIu64 "\n",
+                                   i, (char *)name, *(uint64_t *)total);
+        }
+        if (s->idle) {
+            g_string_append_printf(buf, "cpu%u;[idle] %" PRIu64 "\n",
+                                   i, s->idle);
+        }
+    }
+    qemu_mutex_unlock(&sampler.lock);
+}
@@ -0,0 +1,19 @@
+/*
+ * Sampling profiler for guest code.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACCEL_TCG_SAMPLER_H
+#define ACCEL_TCG_SAMPLER_H
+
+/* Start sampling every vCPU @frequency times per second. */
+void tcg_sampler_start(uint32_t frequency);
+
+/* Stop sampling, keeping the samples collected so far. */
+void tcg_sampler_stop(void);
+
+/* Append the samples to @buf in folded stack format. */
+void tcg_sampler_dump(GString *buf);
+
+#endif
@@ -34,7 +34,15 @@ struct TBContext {
 
     /* statistics */
     unsigned tb_flush_count;
+    unsigned tb_reclaim_count;
     unsigned tb_phys_invalidate_count;
+    /* guest writes to pages with code, and those that missed the code */
+    unsigned smc_write_count;
+    unsigned smc_write_elided_count;
+    /* TBs invalidated because their code was written to */
+    unsigned smc_invalidate_count;
+    /* instructions re-executed with all other vCPUs stopped */
+    unsigned exclusive_step_count;
 };
 
 extern TBContext tb_ctx;
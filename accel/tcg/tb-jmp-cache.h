@@ -9,20 +9,68 @@
 #ifndef ACCEL_TCG_TB_JMP_CACHE_H
 #define ACCEL_TCG_TB_JMP_CACHE_H
 
+#include "qemu/atomic.h"
+#include "qemu/rcu.h"
+
+/*
+ * The total number of entries is 1 << tb_jmp_cache_bits, split into
+ * sets of tb_jmp_cache_ways entries each.  Both can be changed with
+ * the jmp-cache-bits and jmp-cache-ways properties of the tcg accel.
+ */
 #define TB_JMP_CACHE_BITS 12
-#define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
+#define TB_JMP_CACHE_MIN_BITS 8
+#define TB_JMP_CACHE_MAX_BITS 20
+#define TB_JMP_CACHE_MAX_WAYS 4
+
+extern unsigned tb_jmp_cache_bits;
+extern unsigned tb_jmp_cache_ways;
+
+typedef struct CPUJumpCacheEntry {
+    TranslationBlock *tb;
+    target_ulong pc;
+} CPUJumpCacheEntry;
 
 /*
  * Accessed in parallel; all accesses to 'tb' must be atomic.
  * For CF_PCREL, accesses to 'pc' must be protected by a
  * load_acquire/store_release to 'tb'.
+ *
+ * Entries are only ever written with a non-NULL 'tb' by the owning
+ * vCPU thread; other threads only clear them.
  */
 struct CPUJumpCache {
     struct rcu_head rcu;
-    struct {
-        TranslationBlock *tb;
-        target_ulong pc;
-    } array[TB_JMP_CACHE_SIZE];
+    unsigned set_bits;  /* log2 of the number of sets */
+    unsigned way_bits;  /* log2 of the number of entries per set */
+    /* statistics, written only by the owning vCPU thread */
+    size_t hits;
+    size_t misses;
+    CPUJumpCacheEntry array[];
 };
 
+static inline size_t tb_jmp_cache_entries(const CPUJumpCache *jc)
+{
+    return (size_t)1 << (jc->set_bits + jc->way_bits);
+}
+
+/*
+ * Insert @tb for @pc at the head of @set, evicting the oldest way.
+ * A concurrent invalidation may clear an entry while it is being
+ * shifted down, leaving a stale copy behind; that is harmless, as an
+ * invalidated TB has CF_INVALID set and never matches a lookup.
+ */
+static inline void tb_jmp_cache_insert(CPUJumpCache *jc,
+                                       CPUJumpCacheEntry *set,
+                                       target_ulong pc,
+                                       TranslationBlock *tb)
+{
+    for (unsigned i = (1u << jc->way_bits) - 1; i > 0; i--) {
+        set[i].pc = set[i - 1].pc;
+        qatomic_store_release(&set[i].tb, qatomic_read(&set[i - 1].tb));
+    }
+    set[0].pc = pc;
+    /* Ensure pc is written first. */
+    qatomic_store_release(&set[0].tb, tb);
+}
+
 #endif /* ACCEL_TCG_TB_JMP_CACHE_H */
@@ -20,6 +20,7 @@
 #include "qemu/osdep.h"
 #include "qemu/interval-tree.h"
 #include "qemu/qtree.h"
+#include "qemu/bitmap.h"
 #include "exec/cputlb.h"
 #include "exec/log.h"
 #include "exec/exec-all.h"
@@ -187,10 +188,24 @@ static int v_l2_levels;
 
 static void *l1_map[V_L1_MAX_SIZE];
 
+/*
+ * Code presence is tracked in 1/64ths of a page, i.e. 64 byte granules
+ * for 4 KiB pages, so that writes next to translated code need not take
+ * the page locks to find that there is nothing to invalidate.
+ */
+#define PAGE_CODE_GRANULES      64
+#define PAGE_CODE_GRANULE_SHIFT (TARGET_PAGE_BITS - 6)
+
 struct PageDesc {
     QemuSpin lock;
     /* list of TBs intersecting this ram page */
     uintptr_t first_tb;
+    /*
+     * Granules that may hold code of a TB in first_tb.  Bits are set
+     * under the lock as TBs are added and are only cleared when the
+     * page's TBs are invalidated, so this is a superset of the live code.
+     */
+    unsigned long code_bitmap[BITS_TO_LONGS(PAGE_CODE_GRANULES)];
 };
 
 void page_table_config_init(void)
@@ -580,6 +595,7 @@ static void tb_remove_all_1(int level, void **lp)
         for (i = 0; i < V_L2_SIZE; ++i) {
             page_lock(&pd[i]);
             pd[i].first_tb = (uintptr_t)NULL;
+            bitmap_zero(pd[i].code_bitmap, PAGE_CODE_GRANULES);
             page_unlock(&pd[i]);
         }
     } else {
@@ -600,6 +616,72 @@ static void tb_remove_all(void)
     }
 }
 
+/*
+ * Return in [@pstart, @plast] the part of @tb that lies in its @n-th page.
+ * NOTE: this is subtle as a TB may span two physical pages.
+ */
+static void tb_page_range(const TranslationBlock *tb, unsigned int n,
+                          tb_page_addr_t *pstart, tb_page_addr_t *plast)
+{
+    tb_page_addr_t tb_start, tb_last;
+
+    tb_start = tb_page_addr0(tb);
+    tb_last = tb_start + tb->size - 1;
+    if (n == 0) {
+        tb_last = MIN(tb_last, tb_start | ~TARGET_PAGE_MASK);
+    } else {
+        tb_start = tb_page_addr1(tb);
+        tb_last = tb_start + (tb_last & ~TARGET_PAGE_MASK);
+    }
+    *pstart = tb_start;
+    *plast = tb_last;
+}
+
+static void page_code_bitmap_set(unsigned long *map, const TranslationBlock *tb,
+                                 unsigned int n)
+{
+    tb_page_addr_t start, last;
+    long first;
+
+    tb_page_range(tb, n, &start, &last);
+    first = (start & ~TARGET_PAGE_MASK) >> PAGE_CODE_GRANULE_SHIFT;
+    bitmap_set_atomic(map, first,
+                      ((last & ~TARGET_PAGE_MASK) >> PAGE_CODE_GRANULE_SHIFT)
+                      - first + 1);
+}
+
+/*
+ * Rebuild the code bitmap of @p from its remaining TBs.
+ * Called with @p->lock held.
+ */
+static void page_code_bitmap_rebuild(PageDesc *p)
+{
+    DECLARE_BITMAP(map, PAGE_CODE_GRANULES) = { };
+    TranslationBlock *tb;
+    PageForEachNext n;
+    int i;
+
+    assert_page_locked(p);
+    PAGE_FOR_EACH_TB(unused, unused, p, tb, n) {
+        page_code_bitmap_set(map, tb, n);
+    }
+    /* Lockless readers must never see the bits of a live TB cleared. */
+    for (i = 0; i < BITS_TO_LONGS(PAGE_CODE_GRANULES); i++) {
+        qatomic_set(&p->code_bitmap[i], map[i]);
+    }
+}
+
+/* Return true if [@start, @last], within one page, may hold code. */
+static bool page_code_present(PageDesc *p, tb_page_addr_t start,
+                              tb_page_addr_t last)
+{
+    unsigned long first = (start & ~TARGET_PAGE_MASK) >> PAGE_CODE_GRANULE_SHIFT;
+    unsigned long end = ((last & ~TARGET_PAGE_MASK) >>
+                         PAGE_CODE_GRANULE_SHIFT) + 1;
+
+    return find_next_bit(p->code_bitmap, end, first) < end;
+}
+
 /*
  * Add the tb in the target page and protect it if necessary.
  * Called with @p->lock held.
@@ -614,6 +696,7 @@ static inline void tb_page_add(PageDesc *p, TranslationBlock *tb,
     tb->page_next[n] = p->first_tb;
     page_already_protected = p->first_tb != 0;
     p->first_tb = (uintptr_t)tb | n;
+    page_code_bitmap_set(p->code_bitmap, tb, n);
 
     /*
      * If some code is already present, then the pages are already
@@ -746,6 +829,8 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     tcg_region_reset_all();
     /* XXX: flush processor icache at this point if cache flush is expensive */
     qatomic_inc(&tb_ctx.tb_flush_count);
+    /* Pending reclaims are moot after everything has been reclaimed. */
+    qatomic_inc(&tb_ctx.tb_reclaim_count);
 
 done:
     mmap_unlock();
@@ -768,6 +853,72 @@ void tb_flush(CPUState *cpu)
     }
 }
 
+static gboolean tb_reclaim_invalidate(gpointer key, gpointer value,
+                                      gpointer data)
+{
+    TranslationBlock *tb = value;
+
+    tb_phys_invalidate(tb, -1);
+    return false;
+}
+
+/* reclaim the oldest code regions, or flush everything if there are none */
+static void do_tb_reclaim(CPUState *cpu, run_on_cpu_data tb_reclaim_count)
+{
+    unsigned tb_flush_count;
+
+    mmap_lock();
+    /* If it is already been done on request of another CPU, just retry. */
+    if (tb_ctx.tb_reclaim_count != tb_reclaim_count.host_int) {
+        mmap_unlock();
+        return;
+    }
+
+    /*
+     * Plugin callback arrays are not tracked per TB, so they
+     * can only be freed by a full flush, which also tells the plugins.
+     */
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask) ||
+        test_bit(QEMU_PLUGIN_EV_VCPU_MEM_TRACE, cpu->plugin_mask)) {
+        goto flush;
+    }
+
+    qemu_thread_jit_write();
+    if (tcg_region_reclaim(tb_reclaim_invalidate, NULL)) {
+        /*
+         * The jump caches can still point to TBs that were invalidated
+         * earlier, which tb_phys_invalidate() skipped above; their code
+         * is about to be reused.
+         */
+        CPU_FOREACH(cpu) {
+            tcg_flush_jmp_cache(cpu);
+        }
+        qatomic_inc(&tb_ctx.tb_reclaim_count);
+        qemu_thread_jit_execute();
+        mmap_unlock();
+        return;
+    }
+    qemu_thread_jit_execute();
+
+flush:
+    tb_flush_count = tb_ctx.tb_flush_count;
+    mmap_unlock();
+
+    do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(tb_flush_count));
+}
+
+void tb_reclaim(CPUState *cpu)
+{
+    unsigned tb_reclaim_count = qatomic_read(&tb_ctx.tb_reclaim_count);
+
+    if (cpu_in_serial_context(cpu)) {
+        do_tb_reclaim(cpu, RUN_ON_CPU_HOST_INT(tb_reclaim_count));
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_reclaim,
+                              RUN_ON_CPU_HOST_INT(tb_reclaim_count));
+    }
+}
+
 /* remove @orig from its @n_orig-th jump list */
 static inline void tb_remove_from_jmp_list(TranslationBlock *orig, int n_orig)
 {
@@ -854,13 +1005,14 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
             tcg_flush_jmp_cache(cpu);
         }
     } else {
-        uint32_t h = tb_jmp_cache_hash_func(tb->pc);
-
         CPU_FOREACH(cpu) {
             CPUJumpCache *jc = cpu->tb_jmp_cache;
+            CPUJumpCacheEntry *set = tb_jmp_cache_set(jc, tb->pc);
 
-            if (qatomic_read(&jc->array[h].tb) == tb) {
-                qatomic_set(&jc->array[h].tb, NULL);
+            for (unsigned i = 0; i < 1u << jc->way_bits; i++) {
+                if (qatomic_read(&set[i].tb) == tb) {
+                    qatomic_set(&set[i].tb, NULL);
+                }
             }
         }
     }
@@ -986,11 +1138,11 @@ TranslationBlock *tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
 
 #ifdef CONFIG_USER_ONLY
 /*
- * Invalidate all TBs which intersect with the target address range.
- * Called with mmap_lock held for user-mode emulation.
- * NOTE: this function must not be called while a TB is running.
+ * Invalidate all TBs which intersect with the target address range,
+ * counting them as SMC invalidations if @smc.
  */
-void tb_invalidate_phys_range(tb_page_addr_t start, tb_page_addr_t last)
+static void tb_invalidate_phys_range_1(tb_page_addr_t start,
+                                       tb_page_addr_t last, bool smc)
 {
     TranslationBlock *tb;
     PageForEachNext n;
@@ -999,9 +1151,22 @@ void tb_invalidate_phys_range(tb_page_addr_t start, tb_page_addr_t last)
 
     PAGE_FOR_EACH_TB(start, last, unused, tb, n) {
         tb_phys_invalidate__locked(tb);
+        if (smc) {
+            qatomic_inc(&tb_ctx.smc_invalidate_count);
+        }
     }
 }
 
+/*
+ * Invalidate all TBs which intersect with the target address range.
+ * Called with mmap_lock held for user-mode emulation.
+ * NOTE: this function must not be called while a TB is running.
+ */
+void tb_invalidate_phys_range(tb_page_addr_t start, tb_page_addr_t last)
+{
+    tb_invalidate_phys_range_1(start, last, false);
+}
+
 /*
  * Invalidate all TBs which intersect with the target address page @addr.
  * Called with mmap_lock held for user-mode emulation
@@ -1031,6 +1196,8 @@ bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc)
     PageForEachNext n;
     tb_page_addr_t last;
 
+    qatomic_inc(&tb_ctx.smc_write_count);
+
     /*
      * Without precise smc semantics, or when outside of a TB,
      * we can skip to invalidate.
@@ -1039,7 +1206,8 @@ bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc)
     pc = 0;
 #endif
     if (!pc) {
-        tb_invalidate_phys_page(addr);
+        tb_invalidate_phys_range_1(addr & TARGET_PAGE_MASK,
+                                   addr | ~TARGET_PAGE_MASK, true);
         return false;
     }
 
@@ -1064,6 +1232,7 @@ bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc)
             cpu_restore_state_from_tb(current_cpu, current_tb, pc);
         }
         tb_phys_invalidate__locked(tb);
+        qatomic_inc(&tb_ctx.smc_invalidate_count);
     }
 
     if (current_tb_modified) {
@@ -1087,6 +1256,7 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
 {
     TranslationBlock *tb;
     PageForEachNext n;
+    bool invalidated = false;
 #ifdef TARGET_HAS_PRECISE_SMC
     bool current_tb_modified = false;
     TranslationBlock *current_tb = retaddr ? tcg_tb_lookup(retaddr) : NULL;
@@ -1099,15 +1269,7 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
     PAGE_FOR_EACH_TB(start, last, p, tb, n) {
         tb_page_addr_t tb_start, tb_last;
 
-        /* NOTE: this is subtle as a TB may span two physical pages */
-        tb_start = tb_page_addr0(tb);
-        tb_last = tb_start + tb->size - 1;
-        if (n == 0) {
-            tb_last = MIN(tb_last, tb_start | ~TARGET_PAGE_MASK);
-        } else {
-            tb_start = tb_page_addr1(tb);
-            tb_last = tb_start + (tb_last & ~TARGET_PAGE_MASK);
-        }
+        tb_page_range(tb, n, &tb_start, &tb_last);
         if (!(tb_last < start || tb_start > last)) {
 #ifdef TARGET_HAS_PRECISE_SMC
             if (current_tb == tb &&
@@ -1124,6 +1286,8 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
             }
 #endif /* TARGET_HAS_PRECISE_SMC */
             tb_phys_invalidate__locked(tb);
+            invalidated = true;
+            qatomic_inc(&tb_ctx.smc_invalidate_count);
         }
     }
 
@@ -1131,6 +1295,9 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
     if (!p->first_tb) {
         tlb_unprotect_code(start);
     }
+    if (invalidated) {
+        page_code_bitmap_rebuild(p);
+    }
 
 #ifdef TARGET_HAS_PRECISE_SMC
     if (current_tb_modified) {
@@ -1223,6 +1390,23 @@ void tb_invalidate_phys_range_fast(ram_addr_t ram_addr,
                                    uintptr_t retaddr)
 {
     struct page_collection *pages;
+    PageDesc *p = page_find(ram_addr >> TARGET_PAGE_BITS);
+
+    qatomic_inc(&tb_ctx.smc_write_count);
+
+    /*
+     * Most writes to a page with code do not touch the code itself.
+     * Skip the page collection for those.  Like the locked walk below,
+     * this cannot see a TB that has been translated but not yet linked.
+     * A page without any TB left, e.g. after tb_flush(), still takes
+     * the locked walk so that it is unprotected.
+     */
+    if (p == NULL ||
+        (qatomic_read(&p->first_tb) != 0 &&
+         !page_code_present(p, ram_addr, ram_addr + size - 1))) {
+        qatomic_inc(&tb_ctx.smc_write_elided_count);
+        return;
+    }
 
     pages = page_collection_lock(ram_addr, ram_addr + size - 1);
     tb_invalidate_phys_page_fast__locked(pages, ram_addr, size, retaddr);
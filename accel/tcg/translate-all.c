@@ -335,8 +335,8 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
  buffer_overflow:
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        /* reclaim the oldest regions, or flush if there are none */
+        tb_reclaim(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -685,6 +685,28 @@ static void print_qht_statistics(struct qht_stats hst, GString *buf)
     g_free(hgram);
 }
 
+static void print_jmp_cache_statistics(GString *buf)
+{
+    size_t hits = 0, misses = 0;
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        CPUJumpCache *jc = cpu->tb_jmp_cache;
+
+        if (jc) {
+            hits += qatomic_read(&jc->hits);
+            misses += qatomic_read(&jc->misses);
+        }
+    }
+    g_string_append_printf(buf, "TB jmp cache        %u entries, %u-way\n",
+                           1u << tb_jmp_cache_bits, tb_jmp_cache_ways);
+    g_string_append_printf(buf, "TB jmp cache hits   %zu (%0.2f%%), "
+                           "misses %zu\n", hits,
+                           hits + misses ?
+                           (double)hits / (hits + misses) * 100 : 0,
+                           misses);
+}
+
 struct tb_tree_stats {
     size_t nb_tbs;
     size_t host_size;
@@ -722,7 +744,7 @@ void dump_exec_info(GString *buf)
 {
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
-    size_t nb_tbs, flush_full, flush_part, flush_elide;
+    size_t nb_tbs, flush_full, flush_part, flush_elide, flush_coalesce;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -758,16 +780,28 @@ void dump_exec_info(GString *buf)
     print_qht_statistics(hst, buf);
     qht_statistics_destroy(&hst);
 
+    print_jmp_cache_statistics(buf);
+
     g_string_append_printf(buf, "\nStatistics:\n");
     g_string_append_printf(buf, "TB flush count      %u\n",
                            qatomic_read(&tb_ctx.tb_flush_count));
+    g_string_append_printf(buf, "TB reclaim count    %u\n",
+                           qatomic_read(&tb_ctx.tb_reclaim_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
-
-    tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
+    g_string_append_printf(buf, "SMC write faults    %u (%u elided)\n",
+                           qatomic_read(&tb_ctx.smc_write_count),
+                           qatomic_read(&tb_ctx.smc_write_elided_count));
+    g_string_append_printf(buf, "SMC invalidations   %u\n",
+                           qatomic_read(&tb_ctx.smc_invalidate_count));
+    g_string_append_printf(buf, "Exclusive steps     %u\n",
+                           qatomic_read(&tb_ctx.exclusive_step_count));
+
+    tlb_flush_counts(&flush_full, &flush_part, &flush_elide, &flush_coalesce);
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+    g_string_append_printf(buf, "TLB merged flushes  %zu\n", flush_coalesce);
     tcg_dump_info(buf);
 }
 
@@ -795,7 +829,7 @@ void tcg_flush_jmp_cache(CPUState *cpu)
         return;
     }
 
-    for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
+    for (size_t i = 0, n = tb_jmp_cache_entries(jc); i < n; i++) {
         qatomic_set(&jc->array[i].tb, NULL);
     }
 }
@@ -401,6 +401,136 @@ float64_gen2(float64 xa, float64 xb, float_status *s,
     return soft(ua.s, ub.s, s);
 }
 
+/*
+ * Hardfloat for float16 and bfloat16.  Single precision has more than
+ * 2p + 2 bits of precision for both formats, so that computing an add,
+ * sub, mul, div or sqrt in single precision and rounding the result to
+ * the narrower format yields the correctly rounded result.
+ *
+ * The format conversions are done with integer arithmetic, and are
+ * limited to zero and normal numbers.  That makes widening exact, and
+ * narrowing a round-to-nearest-even of the fraction.  Anything else,
+ * including overflow and underflow of the result, uses softfloat.
+ */
+
+typedef float16 (*soft_f16_op2_fn)(float16 a, float16 b, float_status *s);
+typedef bfloat16 (*soft_bf16_op2_fn)(bfloat16 a, bfloat16 b, float_status *s);
+
+static inline bool f16_is_zon(float16 a)
+{
+    return float16_is_zero(a) || float16_is_normal(a);
+}
+
+static inline bool bf16_is_zon(bfloat16 a)
+{
+    return bfloat16_is_zero(a) || bfloat16_is_normal(a);
+}
+
+static inline union_float32 f16_to_hard(float16 a)
+{
+    uint32_t sign = (uint32_t)(a & 0x8000) << 16;
+    uint32_t abs = a & 0x7fff;
+    union_float32 r;
+
+    /* Move the fraction into place and rebias the exponent. */
+    r.s = make_float32(abs ? sign | ((abs << 13) + ((127 - 15) << 23)) : sign);
+    return r;
+}
+
+static inline bool f16_from_hard(union_float32 r, float16 *ret)
+{
+    uint32_t sign = float32_val(r.s) & 0x80000000u;
+    uint32_t abs = float32_val(r.s) & 0x7fffffffu;
+
+    if (abs != 0) {
+        /* Below the smallest normal float16, 2**-14. */
+        if (unlikely(abs < ((127 - 14) << 23))) {
+            return false;
+        }
+        abs -= (127 - 15) << 23;
+        abs = (abs + 0xfff + ((abs >> 13) & 1)) >> 13;
+        /* Overflow, or an infinity or nan from the operation. */
+        if (unlikely(abs >= 0x7c00)) {
+            return false;
+        }
+    }
+    *ret = make_float16((sign >> 16) | abs);
+    return true;
+}
+
+static inline union_float32 bf16_to_hard(bfloat16 a)
+{
+    union_float32 r;
+
+    r.s = make_float32((uint32_t)a << 16);
+    return r;
+}
+
+static inline bool bf16_from_hard(union_float32 r, bfloat16 *ret)
+{
+    uint32_t sign = float32_val(r.s) & 0x80000000u;
+    uint32_t abs = float32_val(r.s) & 0x7fffffffu;
+
+    if (abs != 0) {
+        /* The exponent range is that of float32: reject denormals. */
+        if (unlikely(abs < (1 << 23))) {
+            return false;
+        }
+        abs = (abs + 0x7fff + ((abs >> 16) & 1)) >> 16;
+        if (unlikely(abs >= 0x7f80)) {
+            return false;
+        }
+    }
+    *ret = (sign >> 16) | abs;
+    return true;
+}
+
+static inline float16
+float16_gen2(float16 a, float16 b, float_status *s,
+             hard_f32_op2_fn hard, soft_f16_op2_fn soft)
+{
+    union_float32 ur;
+    float16 r;
+
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+    if (unlikely(!f16_is_zon(a) || !f16_is_zon(b))) {
+        goto soft;
+    }
+
+    ur.h = hard(f16_to_hard(a).h, f16_to_hard(b).h);
+    if (likely(f16_from_hard(ur, &r))) {
+        return r;
+    }
+
+ soft:
+    return soft(a, b, s);
+}
+
+static inline bfloat16
+bfloat16_gen2(bfloat16 a, bfloat16 b, float_status *s,
+              hard_f32_op2_fn hard, soft_bf16_op2_fn soft)
+{
+    union_float32 ur;
+    bfloat16 r;
+
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+    if (unlikely(!bf16_is_zon(a) || !bf16_is_zon(b))) {
+        goto soft;
+    }
+
+    ur.h = hard(bf16_to_hard(a).h, bf16_to_hard(b).h);
+    if (likely(bf16_from_hard(ur, &r))) {
+        return r;
+    }
+
+ soft:
+    return soft(a, b, s);
+}
+
 /*
  * Classify a floating point number. Everything above float_class_qnan
  * is a NaN so cls >= float_class_qnan is any NaN.
@@ -1845,8 +1975,8 @@ static floatx80 floatx80_round_pack_canonical(FloatParts128 *p,
  * Addition and subtraction
  */
 
-static float16 QEMU_FLATTEN
-float16_addsub(float16 a, float16 b, float_status *status, bool subtract)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_addsub(float16 a, float16 b, float_status *status, bool subtract)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -1857,14 +1987,14 @@ float16_addsub(float16 a, float16 b, float_status *status, bool subtract)
     return float16_round_pack_canonical(pr, status);
 }
 
-float16 float16_add(float16 a, float16 b, float_status *status)
+static float16 soft_f16_add(float16 a, float16 b, float_status *status)
 {
-    return float16_addsub(a, b, status, false);
+    return soft_f16_addsub(a, b, status, false);
 }
 
-float16 float16_sub(float16 a, float16 b, float_status *status)
+static float16 soft_f16_sub(float16 a, float16 b, float_status *status)
 {
-    return float16_addsub(a, b, status, true);
+    return soft_f16_addsub(a, b, status, true);
 }
 
 static float32 QEMU_SOFTFLOAT_ATTR
@@ -1986,6 +2116,18 @@ float64_sub(float64 a, float64 b, float_status *s)
     return float64_addsub(a, b, s, hard_f64_sub, soft_f64_sub);
 }
 
+float16 QEMU_FLATTEN
+float16_add(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_add, soft_f16_add);
+}
+
+float16 QEMU_FLATTEN
+float16_sub(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_sub, soft_f16_sub);
+}
+
 static float64 float64r32_addsub(float64 a, float64 b, float_status *status,
                                  bool subtract)
 {
@@ -2008,8 +2150,8 @@ float64 float64r32_sub(float64 a, float64 b, float_status *status)
     return float64r32_addsub(a, b, status, true);
 }
 
-static bfloat16 QEMU_FLATTEN
-bfloat16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2020,14 +2162,26 @@ bfloat16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
-bfloat16 bfloat16_add(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 soft_bf16_add(bfloat16 a, bfloat16 b, float_status *status)
 {
-    return bfloat16_addsub(a, b, status, false);
+    return soft_bf16_addsub(a, b, status, false);
 }
 
-bfloat16 bfloat16_sub(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 soft_bf16_sub(bfloat16 a, bfloat16 b, float_status *status)
 {
-    return bfloat16_addsub(a, b, status, true);
+    return soft_bf16_addsub(a, b, status, true);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_add(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_add, soft_bf16_add);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_sub(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_sub, soft_bf16_sub);
 }
 
 static float128 QEMU_FLATTEN
@@ -2080,7 +2234,8 @@ floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status *status)
  * Multiplication
  */
 
-float16 QEMU_FLATTEN float16_mul(float16 a, float16 b, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_mul(float16 a, float16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2139,6 +2294,12 @@ float64_mul(float64 a, float64 b, float_status *s)
                         f64_is_zon2, f64_addsubmul_post);
 }
 
+float16 QEMU_FLATTEN
+float16_mul(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_mul, soft_f16_mul);
+}
+
 float64 float64r32_mul(float64 a, float64 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
@@ -2150,8 +2311,8 @@ float64 float64r32_mul(float64 a, float64 b, float_status *status)
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN
-bfloat16_mul(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_mul(bfloat16 a, bfloat16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2162,6 +2323,12 @@ bfloat16_mul(bfloat16 a, bfloat16 b, float_status *status)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+bfloat16 QEMU_FLATTEN
+bfloat16_mul(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_mul, soft_bf16_mul);
+}
+
 float128 QEMU_FLATTEN
 float128_mul(float128 a, float128 b, float_status *status)
 {
@@ -2420,7 +2587,8 @@ float128 QEMU_FLATTEN float128_muladd(float128 a, float128 b, float128 c,
  * Division
  */
 
-float16 float16_div(float16 a, float16 b, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_div(float16 a, float16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2513,6 +2681,16 @@ float64_div(float64 a, float64 b, float_status *s)
                         f64_div_pre, f64_div_post);
 }
 
+/*
+ * For float16 and bfloat16, a zero divisor produces an infinity or nan
+ * in single precision, which is then rejected in favour of softfloat.
+ */
+float16 QEMU_FLATTEN
+float16_div(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_div, soft_f16_div);
+}
+
 float64 float64r32_div(float64 a, float64 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
@@ -2524,8 +2702,8 @@ float64 float64r32_div(float64 a, float64 b, float_status *status)
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN
-bfloat16_div(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_div(bfloat16 a, bfloat16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2536,6 +2714,12 @@ bfloat16_div(bfloat16 a, bfloat16 b, float_status *status)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+bfloat16 QEMU_FLATTEN
+bfloat16_div(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_div, soft_bf16_div);
+}
+
 float128 QEMU_FLATTEN
 float128_div(float128 a, float128 b, float_status *status)
 {
@@ -2974,6 +3158,18 @@ float32 float32_round_to_int(float32 a, float_status *s)
 {
     FloatParts64 p;
 
+    /* The result is exact or inexact is already set: no flags to raise. */
+    if (likely(can_use_fpu(s))) {
+        union_float32 ua;
+
+        ua.s = a;
+        float32_input_flush1(&ua.s, s);
+        if (likely(!float32_is_any_nan(ua.s))) {
+            ua.h = rintf(ua.h);
+            return ua.s;
+        }
+    }
+
     float32_unpack_canonical(&p, a, s);
     parts_round_to_int(&p, s->float_rounding_mode, 0, s, &float32_params);
     return float32_round_pack_canonical(&p, s);
@@ -2983,6 +3179,17 @@ float64 float64_round_to_int(float64 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (likely(can_use_fpu(s))) {
+        union_float64 ua;
+
+        ua.s = a;
+        float64_input_flush1(&ua.s, s);
+        if (likely(!float64_is_any_nan(ua.s))) {
+            ua.h = rint(ua.h);
+            return ua.s;
+        }
+    }
+
     float64_unpack_canonical(&p, a, s);
     parts_round_to_int(&p, s->float_rounding_mode, 0, s, &float64_params);
     return float64_round_pack_canonical(&p, s);
@@ -3023,6 +3230,65 @@ floatx80 floatx80_round_to_int(floatx80 a, float_status *status)
  * Floating-point to signed integer conversions
  */
 
+/*
+ * Hardfloat for the float32 and float64 to integer conversions, without
+ * scaling and for round-to-nearest-even or round-to-zero.  Within [LO, HI)
+ * the only possible exception is inexact, which can_use_fpu requires to
+ * be set already.  The comparisons are false for a nan, which is left to
+ * softfloat along with the out of range inputs to raise invalid.
+ */
+static inline bool f32_to_int_hard(float32 a, FloatRoundMode rmode, int scale,
+                                   float lo, float hi, float *ret,
+                                   float_status *s)
+{
+    union_float32 ua;
+
+    if (unlikely(scale != 0 || !can_use_fpu(s))) {
+        return false;
+    }
+
+    ua.s = a;
+    float32_input_flush1(&ua.s, s);
+    switch (rmode) {
+    case float_round_nearest_even:
+        ua.h = rintf(ua.h);
+        break;
+    case float_round_to_zero:
+        ua.h = truncf(ua.h);
+        break;
+    default:
+        return false;
+    }
+    *ret = ua.h;
+    return isgreaterequal(ua.h, lo) && isless(ua.h, hi);
+}
+
+static inline bool f64_to_int_hard(float64 a, FloatRoundMode rmode, int scale,
+                                   double lo, double hi, double *ret,
+                                   float_status *s)
+{
+    union_float64 ua;
+
+    if (unlikely(scale != 0 || !can_use_fpu(s))) {
+        return false;
+    }
+
+    ua.s = a;
+    float64_input_flush1(&ua.s, s);
+    switch (rmode) {
+    case float_round_nearest_even:
+        ua.h = rint(ua.h);
+        break;
+    case float_round_to_zero:
+        ua.h = trunc(ua.h);
+        break;
+    default:
+        return false;
+    }
+    *ret = ua.h;
+    return isgreaterequal(ua.h, lo) && isless(ua.h, hi);
+}
+
 int8_t float16_to_int8_scalbn(float16 a, FloatRoundMode rmode, int scale,
                               float_status *s)
 {
@@ -3063,6 +3329,11 @@ int16_t float32_to_int16_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    float r;
+
+    if (f32_to_int_hard(a, rmode, scale, -0x1p15f, 0x1p15f, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT16_MIN, INT16_MAX, s);
@@ -3072,6 +3343,11 @@ int32_t float32_to_int32_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    float r;
+
+    if (f32_to_int_hard(a, rmode, scale, -0x1p31f, 0x1p31f, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT32_MIN, INT32_MAX, s);
@@ -3081,6 +3357,11 @@ int64_t float32_to_int64_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    float r;
+
+    if (f32_to_int_hard(a, rmode, scale, -0x1p63f, 0x1p63f, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT64_MIN, INT64_MAX, s);
@@ -3090,6 +3371,11 @@ int16_t float64_to_int16_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    double r;
+
+    if (f64_to_int_hard(a, rmode, scale, -0x1p15, 0x1p15, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT16_MIN, INT16_MAX, s);
@@ -3099,6 +3385,11 @@ int32_t float64_to_int32_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    double r;
+
+    if (f64_to_int_hard(a, rmode, scale, -0x1p31, 0x1p31, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT32_MIN, INT32_MAX, s);
@@ -3108,6 +3399,11 @@ int64_t float64_to_int64_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    double r;
+
+    if (f64_to_int_hard(a, rmode, scale, -0x1p63, 0x1p63, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT64_MIN, INT64_MAX, s);
@@ -3453,6 +3749,11 @@ uint16_t float32_to_uint16_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    float r;
+
+    if (f32_to_int_hard(a, rmode, scale, 0, 0x1p16f, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT16_MAX, s);
@@ -3462,6 +3763,11 @@ uint32_t float32_to_uint32_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    float r;
+
+    if (f32_to_int_hard(a, rmode, scale, 0, 0x1p32f, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT32_MAX, s);
@@ -3471,6 +3777,11 @@ uint64_t float32_to_uint64_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    float r;
+
+    if (f32_to_int_hard(a, rmode, scale, 0, 0x1p64f, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT64_MAX, s);
@@ -3480,6 +3791,11 @@ uint16_t float64_to_uint16_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    double r;
+
+    if (f64_to_int_hard(a, rmode, scale, 0, 0x1p16, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT16_MAX, s);
@@ -3489,6 +3805,11 @@ uint32_t float64_to_uint32_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    double r;
+
+    if (f64_to_int_hard(a, rmode, scale, 0, 0x1p32, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT32_MAX, s);
@@ -3498,6 +3819,11 @@ uint64_t float64_to_uint64_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    double r;
+
+    if (f64_to_int_hard(a, rmode, scale, 0, 0x1p64, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT64_MAX, s);
@@ -4183,23 +4509,89 @@ static bfloat16 bfloat16_minmax(bfloat16 a, bfloat16 b,
     return bfloat16_round_pack_canonical(pr, s);
 }
 
-static float32 float32_minmax(float32 a, float32 b, float_status *s, int flags)
+static float32 QEMU_FLATTEN
+float32_minmax(float32 a, float32 b, float_status *s, int flags)
 {
     FloatParts64 pa, pb, *pr;
+    union_float32 ua, ub, ur;
+    bool lt;
 
-    float32_unpack_canonical(&pa, a, s);
-    float32_unpack_canonical(&pb, b, s);
+    ua.s = a;
+    ub.s = b;
+
+    if (QEMU_NO_HARDFLOAT) {
+        goto soft;
+    }
+
+    /*
+     * Ordered and distinct operands select one of the inputs unchanged,
+     * with no exception raised.  Leave nans, equal operands (the sign
+     * of zero, or of magnitude ties) and denormal results to softfloat.
+     */
+    float32_input_flush2(&ua.s, &ub.s, s);
+    if (flags & minmax_ismag) {
+        lt = isless(fabsf(ua.h), fabsf(ub.h));
+        if (!lt && !isgreater(fabsf(ua.h), fabsf(ub.h))) {
+            goto soft;
+        }
+    } else {
+        lt = isless(ua.h, ub.h);
+        if (!lt && !isgreater(ua.h, ub.h)) {
+            goto soft;
+        }
+    }
+    ur = lt == !!(flags & minmax_ismin) ? ua : ub;
+    if (likely(float32_is_zero_or_normal(ur.s))) {
+        return ur.s;
+    }
+
+ soft:
+    float32_unpack_canonical(&pa, ua.s, s);
+    float32_unpack_canonical(&pb, ub.s, s);
     pr = parts_minmax(&pa, &pb, s, flags);
 
     return float32_round_pack_canonical(pr, s);
 }
 
-static float64 float64_minmax(float64 a, float64 b, float_status *s, int flags)
+static float64 QEMU_FLATTEN
+float64_minmax(float64 a, float64 b, float_status *s, int flags)
 {
     FloatParts64 pa, pb, *pr;
+    union_float64 ua, ub, ur;
+    bool lt;
 
-    float64_unpack_canonical(&pa, a, s);
-    float64_unpack_canonical(&pb, b, s);
+    ua.s = a;
+    ub.s = b;
+
+    if (QEMU_NO_HARDFLOAT) {
+        goto soft;
+    }
+
+    /*
+     * Ordered and distinct operands select one of the inputs unchanged,
+     * with no exception raised.  Leave nans, equal operands (the sign
+     * of zero, or of magnitude ties) and denormal results to softfloat.
+     */
+    float64_input_flush2(&ua.s, &ub.s, s);
+    if (flags & minmax_ismag) {
+        lt = isless(fabs(ua.h), fabs(ub.h));
+        if (!lt && !isgreater(fabs(ua.h), fabs(ub.h))) {
+            goto soft;
+        }
+    } else {
+        lt = isless(ua.h, ub.h);
+        if (!lt && !isgreater(ua.h, ub.h)) {
+            goto soft;
+        }
+    }
+    ur = lt == !!(flags & minmax_ismin) ? ua : ub;
+    if (likely(float64_is_zero_or_normal(ur.s))) {
+        return ur.s;
+    }
+
+ soft:
+    float64_unpack_canonical(&pa, ua.s, s);
+    float64_unpack_canonical(&pb, ub.s, s);
     pr = parts_minmax(&pa, &pb, s, flags);
 
     return float64_round_pack_canonical(pr, s);
@@ -4493,6 +4885,16 @@ floatx80 floatx80_scalbn(floatx80 a, int n, float_status *status)
 float16 QEMU_FLATTEN float16_sqrt(float16 a, float_status *status)
 {
     FloatParts64 p;
+    union_float32 ur;
+    float16 r;
+
+    /* A negative input produces a nan, which is rejected below. */
+    if (likely(can_use_fpu(status) && f16_is_zon(a))) {
+        ur.h = sqrtf(f16_to_hard(a).h);
+        if (likely(f16_from_hard(ur, &r))) {
+            return r;
+        }
+    }
 
     float16_unpack_canonical(&p, a, status);
     parts_sqrt(&p, status, &float16_params);
@@ -4585,6 +4987,15 @@ float64 float64r32_sqrt(float64 a, float_status *status)
 bfloat16 QEMU_FLATTEN bfloat16_sqrt(bfloat16 a, float_status *status)
 {
     FloatParts64 p;
+    union_float32 ur;
+    bfloat16 r;
+
+    if (likely(can_use_fpu(status) && bf16_is_zon(a))) {
+        ur.h = sqrtf(bf16_to_hard(a).h);
+        if (likely(bf16_from_hard(ur, &r))) {
+            return r;
+        }
+    }
 
     bfloat16_unpack_canonical(&p, a, status);
     parts_sqrt(&p, status, &bfloat16_params);
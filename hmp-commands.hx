@@ -650,6 +650,24 @@ SRST
   whether profiling is on or off.
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tcg-sampler",
+        .args_type  = "op:s,frequency:i?",
+        .params     = "on|off [frequency]",
+        .help       = "start or stop sampling the guest program counter "
+                      "of every vCPU (default frequency: 99 Hz)",
+        .cmd        = hmp_tcg_sampler,
+    },
+#endif
+
+SRST
+``tcg-sampler on|off [frequency]``
+  Start or stop sampling the guest program counter of every vCPU,
+  *frequency* times per second.  Starting discards previous samples;
+  use ``info tcg-samples`` to display them.
+ERST
+
     {
         .name       = "system_reset",
         .args_type  = "",
@@ -66,6 +66,12 @@
 /* use a fully associative victim tlb of 8 entries */
 #define CPU_VTLB_SIZE 8
 
+/* track up to 4 separate regions of large pages per mmu_idx */
+#define CPU_TLB_LARGE_PAGES 4
+
+/* merge up to 16 distinct flushes from other vCPUs before flushing all */
+#define CPU_TLB_PENDING_FLUSHES 16
+
 #define CPU_TLB_DYN_MIN_BITS 6
 #define CPU_TLB_DYN_DEFAULT_BITS 8
 
@@ -142,13 +148,16 @@ typedef struct CPUTLBEntryFull {
  */
 typedef struct CPUTLBDesc {
     /*
-     * Describe a region covering all of the large pages allocated
-     * into the tlb.  When any page within this region is flushed,
-     * we must flush the entire tlb.  The region is matched if
-     * (addr & large_page_mask) == large_page_addr.
+     * Describe regions covering all of the large pages allocated
+     * into the tlb.  When any page within a region is flushed, we
+     * must flush every tlb entry within that region.  Region i is
+     * matched by addr if (addr & large_page[i].mask) ==
+     * large_page[i].addr; unused regions have both fields set to -1.
      */
-    target_ulong large_page_addr;
-    target_ulong large_page_mask;
+    struct {
+        target_ulong addr;
+        target_ulong mask;
+    } large_page[CPU_TLB_LARGE_PAGES];
     /* host time (in ns) at the beginning of the time window */
     int64_t window_begin_ns;
     /* maximum number of entries observed in the window */
@@ -162,6 +171,16 @@ typedef struct CPUTLBDesc {
     CPUTLBEntryFull *fulltlb;
 } CPUTLBDesc;
 
+/*
+ * A page or range flush requested by another vCPU, not yet performed.
+ */
+typedef struct CPUTLBPendingFlush {
+    target_ulong addr;
+    target_ulong len;
+    uint16_t idxmap;
+    uint16_t bits;
+} CPUTLBPendingFlush;
+
 /*
  * Data elements that are shared between all MMU modes.
  */
@@ -174,6 +193,16 @@ typedef struct CPUTLBCommon {
      * Protected by tlb_c.lock.
      */
     uint16_t dirty;
+    /*
+     * Flushes posted by other vCPUs are merged here and performed by a
+     * single work item, queued along with the first of them.
+     * pending_full is the set of mmu_idx to flush entirely.
+     * Protected by tlb_c.lock.
+     */
+    bool pending_queued;
+    uint16_t pending_full;
+    unsigned n_pending;
+    CPUTLBPendingFlush pending[CPU_TLB_PENDING_FLUSHES];
     /*
      * Statistics.  These are not lock protected, but are read and
      * written atomically.  This allows the monitor to print a snapshot
@@ -182,6 +211,7 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    size_t coalesce_flush_count;
 } CPUTLBCommon;
 
 /*
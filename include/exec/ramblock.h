@@ -75,6 +75,15 @@ struct RAMBlock {
      * could not have been valid on the source.
      */
     ram_addr_t postcopy_length;
+
+    /*
+     * With mapped-ram, bitmap of the pages whose current contents are
+     * stored in the migration file, and the location in the file of
+     * that bitmap and of the block's pages.
+     */
+    unsigned long *file_bmap;
+    off_t bitmap_offset;
+    uint64_t pages_offset;
 };
 #endif
 #endif
@@ -315,6 +315,8 @@ struct qemu_work_item;
  *                        to @trace_dstate).
  * @trace_dstate: Dynamic tracing state of events for this vCPU (bitmask).
  * @plugin_mask: Plugin event bitmap. Modified only via async work.
+ * @plugin_mem_trace: Buffer of memory accesses not yet delivered to
+ *    plugins; allocated the first time a plugin asks for a memory trace.
  * @ignore_memory_transaction_failures: Cached copy of the MachineState
  *    flag of the same name: allows the board to suppress calling of the
  *    CPU do_transaction_failed hook function.
@@ -411,6 +413,7 @@ struct CPUState {
 
 #ifdef CONFIG_PLUGIN
     GArray *plugin_mem_cbs;
+    struct qemu_plugin_mem_trace *plugin_mem_trace;
     /* saved iotlb data from io_writex */
     SavedIOTLB saved_iotlb;
 #endif
@@ -62,6 +62,7 @@ union qemu_plugin_cb_sig {
     qemu_plugin_vcpu_mem_cb_t        vcpu_mem;
     qemu_plugin_vcpu_syscall_cb_t    vcpu_syscall;
     qemu_plugin_vcpu_syscall_ret_cb_t vcpu_syscall_ret;
+    qemu_plugin_vcpu_mem_trace_cb_t  vcpu_mem_trace;
     void *generic;
 };
 
@@ -74,6 +75,7 @@ enum plugin_dyn_cb_type {
 enum plugin_dyn_cb_subtype {
     PLUGIN_CB_REGULAR,
     PLUGIN_CB_INLINE,
+    PLUGIN_CB_COND,
     PLUGIN_N_CB_SUBTYPES,
 };
 
@@ -90,13 +92,54 @@ struct qemu_plugin_dyn_cb {
     enum qemu_plugin_mem_rw rw;
     /* fields specific to each dyn_cb type go here */
     union {
+        /*
+         * If @entry.score is NULL the op applies to the single
+         * location pointed to by @userp.
+         */
         struct {
+            qemu_plugin_u64 entry;
             enum qemu_plugin_op op;
             uint64_t imm;
         } inline_insn;
+        struct {
+            qemu_plugin_u64 entry;
+            enum qemu_plugin_cond cond;
+            uint64_t imm;
+        } cond;
     };
 };
 
+/*
+ * Per-vCPU storage for inline ops. @data holds one element per
+ * possible vCPU index; see plugin_grow_scoreboards().
+ */
+struct qemu_plugin_scoreboard {
+    GArray *data;
+    QLIST_ENTRY(qemu_plugin_scoreboard) entry;
+};
+
+/*
+ * Per-vCPU memory trace buffer, see qemu_plugin_register_vcpu_mem_trace_cb.
+ * Translated code appends to @records at @head (modulo the buffer size);
+ * @tail is the first record not yet handed to the plugins. Both only
+ * ever increase and are only touched by the owning vCPU, or by the exit
+ * path once the vCPUs are stopped. @pc is the address of the current
+ * instruction, for accesses made from helpers.
+ *
+ * Translated code reserves room for at most PLUGIN_MEM_TRACE_RESERVE
+ * records at a time, and helpers flush once that many are pending, so
+ * that accesses from helpers cannot eat into a reservation.
+ */
+#define PLUGIN_MEM_TRACE_ENTRIES 4096
+#define PLUGIN_MEM_TRACE_RESERVE (PLUGIN_MEM_TRACE_ENTRIES / 2)
+
+struct qemu_plugin_mem_trace {
+    uint32_t head;
+    uint32_t tail;
+    uint64_t pc;
+    struct qemu_plugin_mem_record records[PLUGIN_MEM_TRACE_ENTRIES];
+};
+
 /* Internal context for instrumenting an instruction */
 struct qemu_plugin_insn {
     GByteArray *data;
@@ -151,6 +194,11 @@ struct qemu_plugin_tb {
     /* if set, the TB calls helpers that might access guest memory */
     bool mem_helper;
 
+    /* if set, memory accesses are appended to the vCPU's trace buffer */
+    bool mem_trace;
+    /* records left in the last trace buffer reservation, when injecting */
+    uint32_t mem_trace_room;
+
     GArray *cbs[PLUGIN_N_CB_SUBTYPES];
 };
 
@@ -199,6 +247,8 @@ void qemu_plugin_vcpu_syscall_ret(CPUState *cpu, int64_t num, int64_t ret);
 void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                              MemOpIdx oi, enum qemu_plugin_mem_rw rw);
 
+void qemu_plugin_vcpu_mem_trace_flush(CPUState *cpu);
+
 void qemu_plugin_flush_cb(void);
 
 void qemu_plugin_atexit_cb(void);
@@ -285,6 +335,9 @@ static inline void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                                            enum qemu_plugin_mem_rw rw)
 { }
 
+static inline void qemu_plugin_vcpu_mem_trace_flush(CPUState *cpu)
+{ }
+
 static inline void qemu_plugin_flush_cb(void)
 { }
 
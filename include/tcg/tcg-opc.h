@@ -307,6 +307,12 @@ DEF(last_generic, 0, 0, 0, TCG_OPF_NOT_PRESENT)
 /* These opcodes are only for use between the tci generator and interpreter. */
 DEF(tci_movi, 1, 0, 1, TCG_OPF_NOT_PRESENT)
 DEF(tci_movl, 1, 0, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_brcond_i32, 0, 2, 2, TCG_OPF_NOT_PRESENT)
+DEF(tci_brcond_i64, 0, 2, 2, TCG_OPF_NOT_PRESENT)
+DEF(tci_ld_add_i32, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_ld_add_i64, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_qemu_ld_a32_ext, 1, 1, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_qemu_ld_a64_ext, 1, 1, 1, TCG_OPF_NOT_PRESENT)
 #endif
 
 #undef DATA64_ARGS
@@ -0,0 +1,116 @@
+/*
+ * QEMU live migration to and from files
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/error-report.h"
+#include "channel.h"
+#include "file.h"
+#include "migration.h"
+#include "io/channel-file.h"
+#include "options.h"
+#include "trace.h"
+
+static struct FileOutgoingArgs {
+    char *fname;
+} outgoing_args;
+
+/*
+ * With mapped-ram every multifd channel opens the migration file on its
+ * own and writes pages at their fixed offsets, so there is no handshake:
+ * the channel is handed to @f as soon as the file is open.
+ */
+void file_send_channel_create(QIOTaskFunc f, void *data)
+{
+    QIOChannelFile *fioc;
+    QIOTask *task;
+    Error *err = NULL;
+
+    fioc = qio_channel_file_new_path(outgoing_args.fname, O_WRONLY, 0, &err);
+
+    task = qio_task_new(OBJECT(fioc), f, data, NULL);
+    if (fioc) {
+        qio_channel_set_name(QIO_CHANNEL(fioc), "migration-file-multifd");
+    } else {
+        qio_task_set_error(task, err);
+    }
+    qio_task_complete(task);
+}
+
+void file_start_outgoing_migration(MigrationState *s, const char *filename,
+                                   Error **errp)
+{
+    QIOChannelFile *fioc;
+    QIOChannel *ioc;
+
+    trace_migration_file_outgoing(filename);
+
+    fioc = qio_channel_file_new_path(filename, O_CREAT | O_WRONLY | O_TRUNC,
+                                     0600, errp);
+    if (!fioc) {
+        return;
+    }
+
+    g_free(outgoing_args.fname);
+    outgoing_args.fname = g_strdup(filename);
+
+    ioc = QIO_CHANNEL(fioc);
+    qio_channel_set_name(ioc, "migration-file-outgoing");
+    migration_channel_connect(s, ioc, NULL, NULL);
+    object_unref(OBJECT(ioc));
+}
+
+static gboolean file_accept_incoming_migration(QIOChannel *ioc,
+                                               GIOCondition condition,
+                                               gpointer opaque)
+{
+    const char *filename = opaque;
+    Error *local_err = NULL;
+    int i;
+
+    migration_channel_process_incoming(ioc);
+    object_unref(OBJECT(ioc));
+
+    /*
+     * The main channel must be processed first, so that the multifd
+     * channels are not mistaken for it.  With mapped-ram they read the
+     * pages from the same file, at the offsets the main channel finds.
+     */
+    for (i = 0; migrate_multifd() && i < migrate_multifd_channels(); i++) {
+        QIOChannelFile *fioc;
+
+        fioc = qio_channel_file_new_path(filename, O_RDONLY, 0, &local_err);
+        if (!fioc) {
+            error_report_err(local_err);
+            break;
+        }
+        qio_channel_set_name(QIO_CHANNEL(fioc), "migration-file-multifd");
+        migration_channel_process_incoming(QIO_CHANNEL(fioc));
+        object_unref(OBJECT(fioc));
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+void file_start_incoming_migration(const char *filename, Error **errp)
+{
+    QIOChannelFile *fioc;
+    QIOChannel *ioc;
+
+    trace_migration_file_incoming(filename);
+
+    fioc = qio_channel_file_new_path(filename, O_RDONLY, 0, errp);
+    if (!fioc) {
+        return;
+    }
+
+    ioc = QIO_CHANNEL(fioc);
+    qio_channel_set_name(ioc, "migration-file-incoming");
+    qio_channel_add_watch_full(ioc, G_IO_IN,
+                               file_accept_incoming_migration,
+                               g_strdup(filename), g_free,
+                               g_main_context_get_thread_default());
+}
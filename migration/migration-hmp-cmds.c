@@ -206,6 +206,23 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
         g_free(str);
         visit_free(v);
     }
+
+    if (info->downtime_info) {
+        MigrationDowntimePhaseTimeList *phase;
+        MigrationDowntimeDeviceList *dev;
+
+        monitor_printf(mon, "downtime breakdown:\n");
+        for (phase = info->downtime_info->phases; phase; phase = phase->next) {
+            monitor_printf(mon, "  %s: %" PRIu64 " us\n",
+                           MigrationDowntimePhase_str(phase->value->phase),
+                           phase->value->time);
+        }
+        for (dev = info->downtime_info->devices; dev; dev = dev->next) {
+            monitor_printf(mon, "  %s/%u: %" PRIu64 " us\n",
+                           dev->value->idstr, dev->value->instance_id,
+                           dev->value->time);
+        }
+    }
     if (info->has_socket_address) {
         SocketAddressList *addr;
 
@@ -20,6 +20,7 @@
 #include "migration/blocker.h"
 #include "exec.h"
 #include "fd.h"
+#include "file.h"
 #include "socket.h"
 #include "sysemu/runstate.h"
 #include "sysemu/sysemu.h"
@@ -104,6 +105,11 @@ static bool migration_needs_multiple_sockets(void)
 
 static bool uri_supports_multi_channels(const char *uri)
 {
+    /* Each channel opens the file and owns the pages it writes there */
+    if (strstart(uri, "file:", NULL)) {
+        return migrate_mapped_ram();
+    }
+
     return strstart(uri, "tcp:", NULL) || strstart(uri, "unix:", NULL) ||
            strstart(uri, "vsock:", NULL);
 }
@@ -117,6 +123,11 @@ migration_channels_and_uri_compatible(const char *uri, Error **errp)
         return false;
     }
 
+    if (migrate_mapped_ram() && !strstart(uri, "file:", NULL)) {
+        error_setg(errp, "Mapped-ram migration requires a file: URI");
+        return false;
+    }
+
     return true;
 }
 
@@ -152,6 +163,7 @@ void migration_object_init(void)
 
     qemu_mutex_init(&current_incoming->page_request_mutex);
     current_incoming->page_requested = g_tree_new(page_request_addr_cmp);
+    migration_downtime_init(&current_incoming->downtime_stats);
 
     migration_object_check(current_migration, &error_fatal);
 
@@ -442,6 +454,8 @@ static void qemu_start_incoming_migration(const char *uri, Error **errp)
         exec_start_incoming_migration(p, errp);
     } else if (strstart(uri, "fd:", &p)) {
         fd_start_incoming_migration(p, errp);
+    } else if (strstart(uri, "file:", &p)) {
+        file_start_incoming_migration(p, errp);
     } else {
         error_setg(errp, "unknown migration protocol: %s", uri);
     }
@@ -451,6 +465,7 @@ static void process_incoming_migration_bh(void *opaque)
 {
     Error *local_err = NULL;
     MigrationIncomingState *mis = opaque;
+    int64_t start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
 
     /* If capability late_block_activate is set:
      * Only fire up the block code now if we're going to restart the
@@ -494,6 +509,8 @@ static void process_incoming_migration_bh(void *opaque)
     } else {
         runstate_set(global_state_get_runstate());
     }
+    migration_downtime_phase(&mis->downtime_stats,
+                             MIGRATION_DOWNTIME_PHASE_VM_START, start);
     /*
      * This must happen after any state changes since as soon as an external
      * observer sees this event they might start to prod at the VM assuming
@@ -878,6 +895,82 @@ bool migration_is_running(int state)
     }
 }
 
+void migration_downtime_init(MigrationDowntimeStats *stats)
+{
+    qemu_mutex_init(&stats->lock);
+    migration_downtime_reset(stats);
+}
+
+void migration_downtime_destroy(MigrationDowntimeStats *stats)
+{
+    qapi_free_MigrationDowntimeDeviceList(stats->devices);
+    stats->devices = NULL;
+    qemu_mutex_destroy(&stats->lock);
+}
+
+void migration_downtime_reset(MigrationDowntimeStats *stats)
+{
+    int i;
+
+    QEMU_LOCK_GUARD(&stats->lock);
+    for (i = 0; i < MIGRATION_DOWNTIME_PHASE__MAX; i++) {
+        stats->phase[i] = -1;
+    }
+    qapi_free_MigrationDowntimeDeviceList(stats->devices);
+    stats->devices = NULL;
+    stats->devices_tail = &stats->devices;
+}
+
+/* Account the time since @start (in microseconds) to @phase. */
+void migration_downtime_phase(MigrationDowntimeStats *stats,
+                              MigrationDowntimePhase phase, int64_t start)
+{
+    int64_t time = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start;
+
+    QEMU_LOCK_GUARD(&stats->lock);
+    stats->phase[phase] = MAX(stats->phase[phase], 0) + time;
+}
+
+/* Record the time since @start (in microseconds) spent on a section. */
+void migration_downtime_device(MigrationDowntimeStats *stats,
+                               const char *idstr, uint32_t instance_id,
+                               int64_t start)
+{
+    MigrationDowntimeDevice *dev = g_new0(MigrationDowntimeDevice, 1);
+
+    dev->idstr = g_strdup(idstr);
+    dev->instance_id = instance_id;
+    dev->time = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start;
+
+    QEMU_LOCK_GUARD(&stats->lock);
+    QAPI_LIST_APPEND(stats->devices_tail, dev);
+}
+
+static MigrationDowntimeInfo *
+migration_downtime_info(MigrationDowntimeStats *stats)
+{
+    MigrationDowntimeInfo *info = g_new0(MigrationDowntimeInfo, 1);
+    MigrationDowntimePhaseTimeList **tail = &info->phases;
+    int i;
+
+    /* Postcopy reports the downtime while the sections are still saved */
+    QEMU_LOCK_GUARD(&stats->lock);
+    for (i = 0; i < MIGRATION_DOWNTIME_PHASE__MAX; i++) {
+        MigrationDowntimePhaseTime *phase;
+
+        if (stats->phase[i] < 0) {
+            continue;
+        }
+        phase = g_new0(MigrationDowntimePhaseTime, 1);
+        phase->phase = i;
+        phase->time = stats->phase[i];
+        QAPI_LIST_APPEND(tail, phase);
+    }
+    info->devices = QAPI_CLONE(MigrationDowntimeDeviceList, stats->devices);
+
+    return info;
+}
+
 static bool migrate_show_downtime(MigrationState *s)
 {
     return (s->state == MIGRATION_STATUS_COMPLETED) || migration_in_postcopy();
@@ -901,6 +994,7 @@ static void populate_time_info(MigrationInfo *info, MigrationState *s)
     if (migrate_show_downtime(s)) {
         info->has_downtime = true;
         info->downtime = s->downtime;
+        info->downtime_info = migration_downtime_info(&s->downtime_stats);
     } else {
         info->has_expected_downtime = true;
         info->expected_downtime = s->expected_downtime;
@@ -1074,6 +1168,7 @@ static void fill_destination_migration_info(MigrationInfo *info)
     case MIGRATION_STATUS_COMPLETED:
         info->has_status = true;
         fill_destination_postcopy_migration_info(info);
+        info->downtime_info = migration_downtime_info(&mis->downtime_stats);
         break;
     }
     info->status = mis->state;
@@ -1390,6 +1485,7 @@ void migrate_init(MigrationState *s)
     s->pages_per_second = 0.0;
     s->downtime = 0;
     s->expected_downtime = 0;
+    migration_downtime_reset(&s->downtime_stats);
     s->setup_time = 0;
     s->start_postcopy = false;
     s->postcopy_after_devices = false;
@@ -1662,6 +1758,8 @@ void qmp_migrate(const char *uri, bool has_blk, bool blk,
         exec_start_outgoing_migration(s, p, &local_err);
     } else if (strstart(uri, "fd:", &p)) {
         fd_start_outgoing_migration(s, p, &local_err);
+    } else if (strstart(uri, "file:", &p)) {
+        file_start_outgoing_migration(s, p, &local_err);
     } else {
         if (!(has_resume && resume)) {
             yank_unregister_instance(MIGRATION_YANK_INSTANCE);
@@ -2282,6 +2380,7 @@ static void migration_completion(MigrationState *s)
 {
     int ret;
     int current_active_state = s->state;
+    int64_t start;
 
     if (s->state == MIGRATION_STATUS_ACTIVE) {
         qemu_mutex_lock_iothread();
@@ -2291,7 +2390,10 @@ static void migration_completion(MigrationState *s)
         s->vm_old_state = runstate_get();
         global_state_store();
 
+        start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
         ret = vm_stop_force_state(RUN_STATE_FINISH_MIGRATE);
+        migration_downtime_phase(&s->downtime_stats,
+                                 MIGRATION_DOWNTIME_PHASE_VM_STOP, start);
         trace_migration_completion_vm_stop(ret);
         if (ret >= 0) {
             ret = migration_maybe_pause(s, &current_active_state,
@@ -2335,6 +2437,8 @@ static void migration_completion(MigrationState *s)
         goto fail;
     }
 
+    start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+
     /*
      * If rp was opened we must clean up the thread before
      * cleaning everything else up (since if there are no failures
@@ -2355,6 +2459,8 @@ static void migration_completion(MigrationState *s)
         trace_migration_completion_file_err();
         goto fail;
     }
+    migration_downtime_phase(&s->downtime_stats,
+                             MIGRATION_DOWNTIME_PHASE_DRAIN, start);
 
     if (migrate_colo() && s->state == MIGRATION_STATUS_ACTIVE) {
         /* COLO does not support postcopy */
@@ -3285,6 +3391,7 @@ static void migration_instance_finalize(Object *obj)
     qemu_sem_destroy(&ms->rp_state.rp_sem);
     qemu_sem_destroy(&ms->rp_state.rp_pong_acks);
     qemu_sem_destroy(&ms->postcopy_qemufile_src_sem);
+    migration_downtime_destroy(&ms->downtime_stats);
     error_free(ms->error);
 }
 
@@ -3308,6 +3415,7 @@ static void migration_instance_init(Object *obj)
     qemu_sem_init(&ms->wait_unplug_sem, 0);
     qemu_sem_init(&ms->postcopy_qemufile_src_sem, 0);
     qemu_mutex_init(&ms->qemu_file_lock);
+    migration_downtime_init(&ms->downtime_stats);
 }
 
 /*
@@ -72,6 +72,17 @@ typedef enum {
     PREEMPT_THREAD_QUIT,
 } PreemptThreadStatus;
 
+/* Timings of the migration downtime, see MigrationDowntimeInfo */
+typedef struct {
+    /* protects the fields below, read by query-migrate */
+    QemuMutex lock;
+    /* Microseconds spent in each phase, -1 if the phase was not reached */
+    int64_t phase[MIGRATION_DOWNTIME_PHASE__MAX];
+    /* Time spent on each migration section, in stream order */
+    MigrationDowntimeDeviceList *devices;
+    MigrationDowntimeDeviceList **devices_tail;
+} MigrationDowntimeStats;
+
 /* State for the incoming migration */
 struct MigrationIncomingState {
     QEMUFile *from_src_file;
@@ -210,6 +221,9 @@ struct MigrationIncomingState {
      * contains valid information.
      */
     QemuMutex page_request_mutex;
+
+    /* Time spent loading device state and restarting the VM */
+    MigrationDowntimeStats downtime_stats;
 };
 
 MigrationIncomingState *migration_incoming_get_current(void);
@@ -440,6 +454,9 @@ struct MigrationState {
 
     /* QEMU_VM_VMDESCRIPTION content filled for all non-iterable devices. */
     JSONWriter *vmdesc;
+
+    /* Breakdown of the downtime of the latest migration */
+    MigrationDowntimeStats downtime_stats;
 };
 
 void migrate_set_state(int *state, int old_state, int new_state);
@@ -500,6 +517,15 @@ bool migration_rate_limit(void);
 void migration_cancel(const Error *error);
 
 void populate_vfio_info(MigrationInfo *info);
+
+void migration_downtime_init(MigrationDowntimeStats *stats);
+void migration_downtime_destroy(MigrationDowntimeStats *stats);
+void migration_downtime_reset(MigrationDowntimeStats *stats);
+void migration_downtime_phase(MigrationDowntimeStats *stats,
+                              MigrationDowntimePhase phase, int64_t start);
+void migration_downtime_device(MigrationDowntimeStats *stats,
+                               const char *idstr, uint32_t instance_id,
+                               int64_t start);
 void postcopy_temp_page_reset(PostcopyTmpPage *tmp_page);
 
 #endif
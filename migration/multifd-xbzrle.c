@@ -0,0 +1,411 @@
+/*
+ * Multifd XBZRLE compression implementation
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/cutils.h"
+#include "qemu/host-utils.h"
+#include "exec/ramblock.h"
+#include "exec/target_page.h"
+#include "qapi/error.h"
+#include "migration.h"
+#include "migration-stats.h"
+#include "options.h"
+#include "page_cache.h"
+#include "xbzrle.h"
+#include "multifd.h"
+
+/* Maximum number of independently locked parts of the page cache */
+#define XBZRLE_CACHE_SHARDS 64
+
+/* Each page record starts with the be16 length of its delta */
+#define XBZRLE_RECORD_HEADER sizeof(uint16_t)
+
+typedef struct {
+    /* protects cache */
+    QemuMutex lock;
+    PageCache *cache;
+} XBZRLECacheShard;
+
+/*
+ * The copies of the pages that were sent last.
+ *
+ * Between two bitmap syncs a page is only queued once, but the next
+ * time it is dirtied it can be sent through any channel, so all
+ * channels share the cache.  Consecutive pages go to different
+ * shards, so that two channels only wait for each other when they
+ * look up pages that land in the same shard.
+ */
+static struct {
+    XBZRLECacheShard *shards;
+    unsigned int shard_bits;
+    /* number of send channels using the cache */
+    unsigned int users;
+} xbzrle_cache;
+
+struct xbzrle_send_data {
+    /* records of the pages to send */
+    uint8_t *buf;
+    /* delta of the current page */
+    uint8_t *encoded_buf;
+};
+
+struct xbzrle_recv_data {
+    /* records of the pages received */
+    uint8_t *buf;
+    /* size of buf */
+    uint32_t buf_len;
+};
+
+static uint32_t xbzrle_buf_len(uint32_t page_count, uint32_t page_size)
+{
+    return page_count * (XBZRLE_RECORD_HEADER + page_size);
+}
+
+static int xbzrle_cache_setup(size_t page_size, Error **errp)
+{
+    uint64_t pages = migrate_xbzrle_cache_size() / page_size;
+    unsigned int shards, i;
+
+    if (xbzrle_cache.users++) {
+        return 0;
+    }
+
+    shards = MIN(XBZRLE_CACHE_SHARDS, pow2floor(MAX(pages, 1)));
+    xbzrle_cache.shard_bits = ctz32(shards);
+    xbzrle_cache.shards = g_new0(XBZRLECacheShard, shards);
+    for (i = 0; i < shards; i++) {
+        XBZRLECacheShard *shard = &xbzrle_cache.shards[i];
+
+        shard->cache = cache_init(pow2floor(pages / shards) * page_size,
+                                  page_size, errp);
+        if (!shard->cache) {
+            return -1;
+        }
+        qemu_mutex_init(&shard->lock);
+    }
+    return 0;
+}
+
+static void xbzrle_cache_cleanup(void)
+{
+    unsigned int i;
+
+    if (--xbzrle_cache.users) {
+        return;
+    }
+
+    for (i = 0; i < 1U << xbzrle_cache.shard_bits; i++) {
+        XBZRLECacheShard *shard = &xbzrle_cache.shards[i];
+
+        if (shard->cache) {
+            cache_fini(shard->cache);
+            qemu_mutex_destroy(&shard->lock);
+        }
+    }
+    g_free(xbzrle_cache.shards);
+    xbzrle_cache.shards = NULL;
+}
+
+/*
+ * xbzrle_cache_shard: find the shard that caches a page
+ *
+ * Returns the shard, and in @key the address of the page inside it.
+ *
+ * @addr: ram_addr_t of the page
+ * @page_size: size of the target pages
+ * @key: address of the page in the shard
+ */
+static XBZRLECacheShard *xbzrle_cache_shard(ram_addr_t addr,
+                                            uint32_t page_size,
+                                            ram_addr_t *key)
+{
+    uint64_t page = addr / page_size;
+
+    /* Drop the shard bits so that the whole shard gets used */
+    *key = (page >> xbzrle_cache.shard_bits) * page_size;
+    return &xbzrle_cache.shards[page &
+                                ((1U << xbzrle_cache.shard_bits) - 1)];
+}
+
+/* Multifd xbzrle compression */
+
+/**
+ * xbzrle_send_setup: setup send side
+ *
+ * Allocate the buffers of the channel, and the page cache shared by
+ * all the channels when this is the first one.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int xbzrle_send_setup(MultiFDSendParams *p, Error **errp)
+{
+    struct xbzrle_send_data *x = g_new0(struct xbzrle_send_data, 1);
+
+    p->data = x;
+    if (xbzrle_cache_setup(p->page_size, errp) < 0) {
+        return -1;
+    }
+
+    x->buf = g_try_malloc(xbzrle_buf_len(p->page_count, p->page_size));
+    x->encoded_buf = g_try_malloc(p->page_size);
+    if (!x->buf || !x->encoded_buf) {
+        error_setg(errp, "multifd %u: out of memory for xbzrle buffers",
+                   p->id);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * xbzrle_send_cleanup: cleanup send side
+ *
+ * Free the buffers of the channel, and the page cache when this is
+ * the last channel using it.
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static void xbzrle_send_cleanup(MultiFDSendParams *p, Error **errp)
+{
+    struct xbzrle_send_data *x = p->data;
+
+    if (!x) {
+        return;
+    }
+
+    xbzrle_cache_cleanup();
+    g_free(x->buf);
+    g_free(x->encoded_buf);
+    g_free(p->data);
+    p->data = NULL;
+}
+
+/**
+ * xbzrle_send_prepare: prepare the pages to be sent
+ *
+ * Every page becomes either a zero page, a delta against the cached
+ * copy, a whole page when there is no usable copy, or nothing at all
+ * when it did not change since it was sent.  The cache is updated
+ * with what the destination will hold.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int xbzrle_send_prepare(MultiFDSendParams *p, Error **errp)
+{
+    struct xbzrle_send_data *x = p->data;
+    RAMBlock *block = p->pages->block;
+    uint64_t generation = stat64_get(&mig_stats.dirty_sync_count);
+    int max_len = MIN(p->page_size, UINT16_MAX);
+    uint32_t normal_num = 0;
+    uint32_t out_size = 0;
+    uint32_t i;
+
+    p->zero_num = 0;
+    for (i = 0; i < p->normal_num; i++) {
+        ram_addr_t offset = p->normal[i];
+        uint8_t *record = x->buf + out_size;
+        uint8_t *data = record + XBZRLE_RECORD_HEADER;
+        XBZRLECacheShard *shard;
+        ram_addr_t key;
+        bool zero;
+        int encoded_len = -1;
+
+        /*
+         * The guest might be writing to the page, so work on a copy:
+         * the cache must end up with exactly the bytes that were sent.
+         */
+        memcpy(data, block->host + offset, p->page_size);
+        zero = buffer_is_zero(data, p->page_size);
+
+        shard = xbzrle_cache_shard(block->offset + offset, p->page_size,
+                                   &key);
+        qemu_mutex_lock(&shard->lock);
+        if (!zero && cache_is_cached(shard->cache, key, generation)) {
+            uint8_t *cached = get_cached_data(shard->cache, key);
+
+            encoded_len = xbzrle_encode_buffer(cached, data, p->page_size,
+                                               x->encoded_buf, max_len);
+            if (encoded_len != 0) {
+                memcpy(cached, data, p->page_size);
+            }
+        } else {
+            /*
+             * A zero page replaces a stale copy, and is worth caching
+             * anyway: small writes to it make small deltas.  We don't
+             * care if this fails, the page is sent whole.
+             */
+            cache_insert(shard->cache, key, data, generation);
+        }
+        qemu_mutex_unlock(&shard->lock);
+
+        if (zero) {
+            p->zero[p->zero_num] = offset;
+            p->zero_num++;
+            continue;
+        }
+        if (encoded_len == 0) {
+            /* The destination already has this page */
+            continue;
+        }
+        if (encoded_len > 0) {
+            stw_be_p(record, encoded_len);
+            memcpy(data, x->encoded_buf, encoded_len);
+            out_size += XBZRLE_RECORD_HEADER + encoded_len;
+        } else {
+            /* A zero length means that the whole page follows */
+            stw_be_p(record, 0);
+            out_size += XBZRLE_RECORD_HEADER + p->page_size;
+        }
+        p->normal[normal_num] = offset;
+        normal_num++;
+    }
+    p->normal_num = normal_num;
+
+    p->iov[p->iovs_num].iov_base = x->buf;
+    p->iov[p->iovs_num].iov_len = out_size;
+    p->iovs_num++;
+    p->next_packet_size = out_size;
+    p->flags |= MULTIFD_FLAG_XBZRLE;
+
+    return 0;
+}
+
+/**
+ * xbzrle_recv_setup: setup receive side
+ *
+ * Create the buffer for the page records.  The destination needs no
+ * cache: deltas apply to the pages it already holds.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int xbzrle_recv_setup(MultiFDRecvParams *p, Error **errp)
+{
+    struct xbzrle_recv_data *x = g_new0(struct xbzrle_recv_data, 1);
+
+    p->data = x;
+    x->buf_len = xbzrle_buf_len(p->page_count, p->page_size);
+    x->buf = g_try_malloc(x->buf_len);
+    if (!x->buf) {
+        error_setg(errp, "multifd %u: out of memory for xbzrle buffer",
+                   p->id);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * xbzrle_recv_cleanup: cleanup receive side
+ *
+ * @p: Params for the channel that we are using
+ */
+static void xbzrle_recv_cleanup(MultiFDRecvParams *p)
+{
+    struct xbzrle_recv_data *x = p->data;
+
+    g_free(x->buf);
+    x->buf = NULL;
+    g_free(p->data);
+    p->data = NULL;
+}
+
+/**
+ * xbzrle_recv_pages: read the data from the channel into actual pages
+ *
+ * Read the page records, and copy or decode them into the pages.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int xbzrle_recv_pages(MultiFDRecvParams *p, Error **errp)
+{
+    struct xbzrle_recv_data *x = p->data;
+    uint32_t in_size = p->next_packet_size;
+    uint32_t flags = p->flags & MULTIFD_FLAG_COMPRESSION_MASK;
+    uint32_t pos = 0;
+    uint32_t i;
+    int ret;
+
+    if (flags != MULTIFD_FLAG_XBZRLE) {
+        error_setg(errp, "multifd %u: flags received %x flags expected %x",
+                   p->id, flags, MULTIFD_FLAG_XBZRLE);
+        return -1;
+    }
+    if (in_size > x->buf_len) {
+        error_setg(errp, "multifd %u: packet size received %u maximum %u",
+                   p->id, in_size, x->buf_len);
+        return -1;
+    }
+    ret = qio_channel_read_all(p->c, (void *)x->buf, in_size, errp);
+    if (ret != 0) {
+        return ret;
+    }
+
+    for (i = 0; i < p->normal_num; i++) {
+        uint8_t *page = p->host + p->normal[i];
+        uint32_t len;
+
+        if (in_size - pos < XBZRLE_RECORD_HEADER) {
+            break;
+        }
+        len = lduw_be_p(x->buf + pos);
+        pos += XBZRLE_RECORD_HEADER;
+
+        if (len == 0) {
+            if (in_size - pos < p->page_size) {
+                break;
+            }
+            memcpy(page, x->buf + pos, p->page_size);
+            pos += p->page_size;
+        } else {
+            if (in_size - pos < len) {
+                break;
+            }
+            if (xbzrle_decode_buffer(x->buf + pos, len, page,
+                                     p->page_size) < 0) {
+                error_setg(errp, "multifd %u: failed to decode page at "
+                           RAM_ADDR_FMT, p->id, p->normal[i]);
+                return -1;
+            }
+            pos += len;
+        }
+    }
+    if (i != p->normal_num || pos != in_size) {
+        error_setg(errp, "multifd %u: packet size received %u does not "
+                   "match the records of %u pages", p->id, in_size,
+                   p->normal_num);
+        return -1;
+    }
+    return 0;
+}
+
+static MultiFDMethods multifd_xbzrle_ops = {
+    .send_setup = xbzrle_send_setup,
+    .send_cleanup = xbzrle_send_cleanup,
+    .send_prepare = xbzrle_send_prepare,
+    .recv_setup = xbzrle_recv_setup,
+    .recv_cleanup = xbzrle_recv_cleanup,
+    .recv_pages = xbzrle_recv_pages
+};
+
+static void multifd_xbzrle_register(void)
+{
+    multifd_register_ops(MULTIFD_COMPRESSION_XBZRLE, &multifd_xbzrle_ops);
+}
+
+migration_init(multifd_xbzrle_register);
@@ -11,6 +11,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/cutils.h"
 #include "qemu/rcu.h"
 #include "exec/target_page.h"
 #include "sysemu/sysemu.h"
@@ -21,6 +22,7 @@
 #include "migration.h"
 #include "migration-stats.h"
 #include "socket.h"
+#include "file.h"
 #include "tls.h"
 #include "qemu-file.h"
 #include "trace.h"
@@ -266,6 +268,7 @@ static void multifd_send_fill_packet(MultiFDSendParams *p)
     packet->flags = cpu_to_be32(p->flags);
     packet->pages_alloc = cpu_to_be32(p->pages->allocated);
     packet->normal_pages = cpu_to_be32(p->normal_num);
+    packet->zero_pages = cpu_to_be32(p->zero_num);
     packet->next_packet_size = cpu_to_be32(p->next_packet_size);
     packet->packet_num = cpu_to_be64(p->packet_num);
 
@@ -279,6 +282,12 @@ static void multifd_send_fill_packet(MultiFDSendParams *p)
 
         packet->offset[i] = cpu_to_be64(temp);
     }
+
+    for (i = 0; i < p->zero_num; i++) {
+        uint64_t temp = p->zero[i];
+
+        packet->offset[p->normal_num + i] = cpu_to_be64(temp);
+    }
 }
 
 static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
@@ -324,10 +333,18 @@ static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
         return -1;
     }
 
+    p->zero_num = be32_to_cpu(packet->zero_pages);
+    if (p->zero_num > packet->pages_alloc - p->normal_num) {
+        error_setg(errp, "multifd: received packet "
+                   "with %u zero pages and expected maximum pages are %u",
+                   p->zero_num, packet->pages_alloc - p->normal_num);
+        return -1;
+    }
+
     p->next_packet_size = be32_to_cpu(packet->next_packet_size);
     p->packet_num = be64_to_cpu(packet->packet_num);
 
-    if (p->normal_num == 0) {
+    if (p->normal_num == 0 && p->zero_num == 0) {
         return 0;
     }
 
@@ -353,6 +370,18 @@ static int multifd_recv_unfill_packet(MultiFDRecvParams *p, Error **errp)
         p->normal[i] = offset;
     }
 
+    for (i = 0; i < p->zero_num; i++) {
+        uint64_t offset = be64_to_cpu(packet->offset[p->normal_num + i]);
+
+        if (offset > (p->block->used_length - p->page_size)) {
+            error_setg(errp, "multifd: offset too long %" PRIu64
+                       " (max " RAM_ADDR_FMT ")",
+                       offset, p->block->used_length);
+            return -1;
+        }
+        p->zero[i] = offset;
+    }
+
     return 0;
 }
 
@@ -469,6 +498,17 @@ int multifd_queue_page(QEMUFile *f, RAMBlock *block, ram_addr_t offset)
     return 1;
 }
 
+/*
+ * Whether zero pages are looked for by the channel threads, either by
+ * the generic code or by the compression method, instead of by the
+ * migration thread.
+ */
+bool multifd_send_zero_page_detect(void)
+{
+    return migrate_multifd_zero_page() ||
+           migrate_multifd_compression() == MULTIFD_COMPRESSION_XBZRLE;
+}
+
 static void multifd_send_terminate_threads(Error *err)
 {
     int i;
@@ -548,6 +588,8 @@ void multifd_save_cleanup(void)
         p->iov = NULL;
         g_free(p->normal);
         p->normal = NULL;
+        g_free(p->zero);
+        p->zero = NULL;
         multifd_send_state->ops->send_cleanup(p, &local_err);
         if (local_err) {
             migrate_set_error(migrate_get_current(), local_err);
@@ -643,6 +685,53 @@ int multifd_send_sync_main(QEMUFile *f)
     return 0;
 }
 
+/*
+ * With mapped-ram there are no packets: each run of contiguous normal
+ * pages is written straight to its place in the migration file, and the
+ * block's file bitmap records which pages the file holds.
+ */
+static int multifd_file_write_pages(MultiFDSendParams *p, RAMBlock *block,
+                                    Error **errp)
+{
+    uint32_t i, j, run;
+
+    for (i = 0; i < p->zero_num; i++) {
+        clear_bit_atomic(p->zero[i] / p->page_size, block->file_bmap);
+    }
+
+    for (i = 0; i < p->normal_num; i += run) {
+        ram_addr_t offset = p->normal[i];
+        size_t size;
+        ssize_t ret;
+
+        for (run = 1; i + run < p->normal_num; run++) {
+            if (p->normal[i + run] != offset + run * p->page_size) {
+                break;
+            }
+        }
+        size = run * p->page_size;
+
+        ret = qio_channel_pwrite(p->c, (char *)block->host + offset, size,
+                                 block->pages_offset + offset, errp);
+        if (ret == -1) {
+            return -1;
+        }
+        if ((size_t)ret != size) {
+            error_setg(errp, "Partial write of size %zd, expected %zu",
+                       ret, size);
+            return -1;
+        }
+
+        for (j = 0; j < run; j++) {
+            set_bit_atomic(offset / p->page_size + j, block->file_bmap);
+        }
+        stat64_add(&mig_stats.multifd_bytes, size);
+        stat64_add(&mig_stats.transferred, size);
+    }
+
+    return 0;
+}
+
 static void *multifd_send_thread(void *opaque)
 {
     MultiFDSendParams *p = opaque;
@@ -650,18 +739,29 @@ static void *multifd_send_thread(void *opaque)
     Error *local_err = NULL;
     int ret = 0;
     bool use_zero_copy_send = migrate_zero_copy_send();
+    bool account_pages = multifd_send_zero_page_detect();
+    /*
+     * xbzrle sorts out the zero pages itself, as it has to see every
+     * page to keep its cache in sync with the destination.
+     */
+    bool use_zero_page = migrate_multifd_zero_page() &&
+        migrate_multifd_compression() != MULTIFD_COMPRESSION_XBZRLE;
+    bool use_mapped_ram = migrate_mapped_ram();
 
     thread = MigrationThreadAdd(p->name, qemu_get_thread_id());
 
     trace_multifd_send_thread_start(p->id);
     rcu_register_thread();
 
-    if (multifd_send_initial_packet(p, &local_err) < 0) {
-        ret = -1;
-        goto out;
+    /* With mapped-ram, the file only holds the pages themselves */
+    if (!use_mapped_ram) {
+        if (multifd_send_initial_packet(p, &local_err) < 0) {
+            ret = -1;
+            goto out;
+        }
+        /* initial packet */
+        p->num_packets = 1;
     }
-    /* initial packet */
-    p->num_packets = 1;
 
     while (true) {
         qemu_sem_post(&multifd_send_state->channels_ready);
@@ -674,8 +774,10 @@ static void *multifd_send_thread(void *opaque)
 
         if (p->pending_job) {
             uint64_t packet_num = p->packet_num;
+            RAMBlock *block = p->pages->block;
             uint32_t flags;
             p->normal_num = 0;
+            p->zero_num = 0;
 
             if (use_zero_copy_send) {
                 p->iovs_num = 0;
@@ -684,22 +786,38 @@ static void *multifd_send_thread(void *opaque)
             }
 
             for (int i = 0; i < p->pages->num; i++) {
-                p->normal[p->normal_num] = p->pages->offset[i];
-                p->normal_num++;
+                ram_addr_t offset = p->pages->offset[i];
+
+                if (use_zero_page &&
+                    buffer_is_zero(p->pages->block->host + offset,
+                                   p->page_size)) {
+                    p->zero[p->zero_num] = offset;
+                    p->zero_num++;
+                } else {
+                    p->normal[p->normal_num] = offset;
+                    p->normal_num++;
+                }
             }
 
-            if (p->normal_num) {
+            if (p->normal_num && !use_mapped_ram) {
                 ret = multifd_send_state->ops->send_prepare(p, &local_err);
                 if (ret != 0) {
                     qemu_mutex_unlock(&p->mutex);
                     break;
                 }
             }
-            multifd_send_fill_packet(p);
+            if (!use_mapped_ram) {
+                multifd_send_fill_packet(p);
+                p->num_packets++;
+            }
             flags = p->flags;
             p->flags = 0;
-            p->num_packets++;
             p->total_normal_pages += p->normal_num;
+            p->total_zero_pages += p->zero_num;
+            if (account_pages) {
+                stat64_add(&mig_stats.normal_pages, p->normal_num);
+                stat64_add(&mig_stats.zero_pages, p->zero_num);
+            }
             p->pages->num = 0;
             p->pages->block = NULL;
             qemu_mutex_unlock(&p->mutex);
@@ -707,29 +825,37 @@ static void *multifd_send_thread(void *opaque)
             trace_multifd_send(p->id, packet_num, p->normal_num, flags,
                                p->next_packet_size);
 
-            if (use_zero_copy_send) {
-                /* Send header first, without zerocopy */
-                ret = qio_channel_write_all(p->c, (void *)p->packet,
-                                            p->packet_len, &local_err);
+            if (use_mapped_ram) {
+                ret = multifd_file_write_pages(p, block, &local_err);
                 if (ret != 0) {
                     break;
                 }
-                stat64_add(&mig_stats.multifd_bytes, p->packet_len);
-                stat64_add(&mig_stats.transferred, p->packet_len);
             } else {
-                /* Send header using the same writev call */
-                p->iov[0].iov_len = p->packet_len;
-                p->iov[0].iov_base = p->packet;
-            }
+                if (use_zero_copy_send) {
+                    /* Send header first, without zerocopy */
+                    ret = qio_channel_write_all(p->c, (void *)p->packet,
+                                                p->packet_len, &local_err);
+                    if (ret != 0) {
+                        break;
+                    }
+                    stat64_add(&mig_stats.multifd_bytes, p->packet_len);
+                    stat64_add(&mig_stats.transferred, p->packet_len);
+                } else {
+                    /* Send header using the same writev call */
+                    p->iov[0].iov_len = p->packet_len;
+                    p->iov[0].iov_base = p->packet;
+                }
 
-            ret = qio_channel_writev_full_all(p->c, p->iov, p->iovs_num, NULL,
-                                              0, p->write_flags, &local_err);
-            if (ret != 0) {
-                break;
-            }
+                ret = qio_channel_writev_full_all(p->c, p->iov, p->iovs_num,
+                                                  NULL, 0, p->write_flags,
+                                                  &local_err);
+                if (ret != 0) {
+                    break;
+                }
 
-            stat64_add(&mig_stats.multifd_bytes, p->next_packet_size);
-            stat64_add(&mig_stats.transferred, p->next_packet_size);
+                stat64_add(&mig_stats.multifd_bytes, p->next_packet_size);
+                stat64_add(&mig_stats.transferred, p->next_packet_size);
+            }
             qemu_mutex_lock(&p->mutex);
             p->pending_job--;
             qemu_mutex_unlock(&p->mutex);
@@ -942,6 +1068,7 @@ int multifd_save_setup(Error **errp)
         /* We need one extra place for the packet header */
         p->iov = g_new0(struct iovec, page_count + 1);
         p->normal = g_new0(ram_addr_t, page_count);
+        p->zero = g_new0(ram_addr_t, page_count);
         p->page_size = qemu_target_page_size();
         p->page_count = page_count;
 
@@ -951,7 +1078,11 @@ int multifd_save_setup(Error **errp)
             p->write_flags = 0;
         }
 
-        socket_send_channel_create(multifd_new_send_channel_async, p);
+        if (migrate_mapped_ram()) {
+            file_send_channel_create(multifd_new_send_channel_async, p);
+        } else {
+            socket_send_channel_create(multifd_new_send_channel_async, p);
+        }
     }
 
     for (i = 0; i < thread_count; i++) {
@@ -974,6 +1105,8 @@ struct {
     int count;
     /* syncs main thread and channels */
     QemuSemaphore sem_sync;
+    /* mapped-ram: recv channels ready for another read */
+    QemuSemaphore channels_ready;
     /* global number of generated multifd packets */
     uint64_t packet_num;
     /* multifd ops */
@@ -1001,6 +1134,7 @@ static void multifd_recv_terminate_threads(Error *err)
 
         qemu_mutex_lock(&p->mutex);
         p->quit = true;
+        qemu_sem_post(&p->sem);
         /*
          * We could arrive here for two reasons:
          *  - normal quit, i.e. everything went fine, just finished
@@ -1049,6 +1183,7 @@ void multifd_load_cleanup(void)
         object_unref(OBJECT(p->c));
         p->c = NULL;
         qemu_mutex_destroy(&p->mutex);
+        qemu_sem_destroy(&p->sem);
         qemu_sem_destroy(&p->sem_sync);
         g_free(p->name);
         p->name = NULL;
@@ -1059,9 +1194,12 @@ void multifd_load_cleanup(void)
         p->iov = NULL;
         g_free(p->normal);
         p->normal = NULL;
+        g_free(p->zero);
+        p->zero = NULL;
         multifd_recv_state->ops->recv_cleanup(p);
     }
     qemu_sem_destroy(&multifd_recv_state->sem_sync);
+    qemu_sem_destroy(&multifd_recv_state->channels_ready);
     g_free(multifd_recv_state->params);
     multifd_recv_state->params = NULL;
     g_free(multifd_recv_state);
@@ -1072,7 +1210,11 @@ void multifd_recv_sync_main(void)
 {
     int i;
 
-    if (!migrate_multifd()) {
+    /*
+     * With mapped-ram the channels get no packets to sync on; loading a
+     * RAM block waits for its reads with multifd_file_recv_sync().
+     */
+    if (!migrate_multifd() || migrate_mapped_ram()) {
         return;
     }
     for (i = 0; i < migrate_multifd_channels(); i++) {
@@ -1131,6 +1273,7 @@ static void *multifd_recv_thread(void *opaque)
                            p->next_packet_size);
         p->num_packets++;
         p->total_normal_pages += p->normal_num;
+        p->total_zero_pages += p->zero_num;
         qemu_mutex_unlock(&p->mutex);
 
         if (p->normal_num) {
@@ -1140,6 +1283,15 @@ static void *multifd_recv_thread(void *opaque)
             }
         }
 
+        for (int i = 0; i < p->zero_num; i++) {
+            void *page = p->host + p->zero[i];
+
+            /* Avoid dirtying pages that are still zero on this side. */
+            if (!buffer_is_zero(page, p->page_size)) {
+                memset(page, 0, p->page_size);
+            }
+        }
+
         if (flags & MULTIFD_FLAG_SYNC) {
             qemu_sem_post(&multifd_recv_state->sem_sync);
             qemu_sem_wait(&p->sem_sync);
@@ -1160,6 +1312,151 @@ static void *multifd_recv_thread(void *opaque)
     return NULL;
 }
 
+/*
+ * With mapped-ram the main thread reads the page bitmaps from the file
+ * and hands every run of pages to a channel, which reads it straight
+ * into guest memory.
+ */
+static void *multifd_file_recv_thread(void *opaque)
+{
+    MultiFDRecvParams *p = opaque;
+    Error *local_err = NULL;
+
+    trace_multifd_recv_thread_start(p->id);
+    rcu_register_thread();
+
+    qemu_sem_post(&multifd_recv_state->channels_ready);
+
+    while (true) {
+        void *host;
+        size_t size;
+        off_t offset;
+        ssize_t ret;
+
+        qemu_sem_wait(&p->sem);
+
+        qemu_mutex_lock(&p->mutex);
+        if (p->quit) {
+            qemu_mutex_unlock(&p->mutex);
+            break;
+        }
+        if (!p->pending_job) {
+            qemu_mutex_unlock(&p->mutex);
+            /* sometimes there are spurious wakeups */
+            continue;
+        }
+        host = p->read_host;
+        size = p->read_size;
+        offset = p->read_offset;
+        qemu_mutex_unlock(&p->mutex);
+
+        ret = qio_channel_pread(p->c, host, size, offset, &local_err);
+        if (ret == -1) {
+            break;
+        }
+        if ((size_t)ret != size) {
+            error_setg(&local_err, "Partial read of size %zd, expected %zu",
+                       ret, size);
+            break;
+        }
+        p->total_normal_pages += size / p->page_size;
+
+        qemu_mutex_lock(&p->mutex);
+        p->pending_job = false;
+        qemu_mutex_unlock(&p->mutex);
+        qemu_sem_post(&multifd_recv_state->channels_ready);
+    }
+
+    if (local_err) {
+        multifd_recv_terminate_threads(local_err);
+        error_free(local_err);
+    }
+    qemu_mutex_lock(&p->mutex);
+    p->running = false;
+    qemu_mutex_unlock(&p->mutex);
+
+    /* Don't leave the main thread waiting for this channel */
+    qemu_sem_post(&multifd_recv_state->channels_ready);
+
+    rcu_unregister_thread();
+    trace_multifd_recv_thread_end(p->id, p->num_packets, p->total_normal_pages);
+
+    return NULL;
+}
+
+/**
+ * multifd_file_recv_queue: read a run of pages on a multifd channel
+ *
+ * Hands the read of @size bytes at @file_offset of the migration file
+ * into @host to the next idle channel, waiting for one if needed.
+ *
+ * Returns 0 for success or -1 if the channels have quit
+ *
+ * @host: where in guest memory the pages go
+ * @size: number of bytes to read
+ * @file_offset: where in the file the pages are
+ */
+int multifd_file_recv_queue(void *host, size_t size, off_t file_offset)
+{
+    static int next_channel;
+    MultiFDRecvParams *p = NULL;
+    int i;
+
+    qemu_sem_wait(&multifd_recv_state->channels_ready);
+
+    next_channel %= migrate_multifd_channels();
+    for (i = next_channel;; i = (i + 1) % migrate_multifd_channels()) {
+        p = &multifd_recv_state->params[i];
+
+        qemu_mutex_lock(&p->mutex);
+        if (p->quit) {
+            error_report("%s: channel %d has already quit!", __func__, i);
+            qemu_mutex_unlock(&p->mutex);
+            return -1;
+        }
+        if (!p->pending_job) {
+            p->pending_job = true;
+            next_channel = (i + 1) % migrate_multifd_channels();
+            break;
+        }
+        qemu_mutex_unlock(&p->mutex);
+    }
+
+    p->read_host = host;
+    p->read_size = size;
+    p->read_offset = file_offset;
+    qemu_mutex_unlock(&p->mutex);
+    qemu_sem_post(&p->sem);
+
+    return 0;
+}
+
+/**
+ * multifd_file_recv_sync: wait for the reads queued on the channels
+ *
+ * Returns 0 once every queued read is done, or -1 if a channel failed
+ */
+int multifd_file_recv_sync(void)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < migrate_multifd_channels(); i++) {
+        qemu_sem_wait(&multifd_recv_state->channels_ready);
+    }
+    for (i = 0; i < migrate_multifd_channels(); i++) {
+        MultiFDRecvParams *p = &multifd_recv_state->params[i];
+
+        WITH_QEMU_LOCK_GUARD(&p->mutex) {
+            if (p->quit) {
+                ret = -1;
+            }
+        }
+        qemu_sem_post(&multifd_recv_state->channels_ready);
+    }
+
+    return ret;
+}
+
 int multifd_load_setup(Error **errp)
 {
     int thread_count;
@@ -1179,14 +1476,17 @@ int multifd_load_setup(Error **errp)
     multifd_recv_state->params = g_new0(MultiFDRecvParams, thread_count);
     qatomic_set(&multifd_recv_state->count, 0);
     qemu_sem_init(&multifd_recv_state->sem_sync, 0);
+    qemu_sem_init(&multifd_recv_state->channels_ready, 0);
     multifd_recv_state->ops = multifd_ops[migrate_multifd_compression()];
 
     for (i = 0; i < thread_count; i++) {
         MultiFDRecvParams *p = &multifd_recv_state->params[i];
 
         qemu_mutex_init(&p->mutex);
+        qemu_sem_init(&p->sem, 0);
         qemu_sem_init(&p->sem_sync, 0);
         p->quit = false;
+        p->pending_job = false;
         p->id = i;
         p->packet_len = sizeof(MultiFDPacket_t)
                       + sizeof(uint64_t) * page_count;
@@ -1194,6 +1494,7 @@ int multifd_load_setup(Error **errp)
         p->name = g_strdup_printf("multifdrecv_%d", i);
         p->iov = g_new0(struct iovec, page_count);
         p->normal = g_new0(ram_addr_t, page_count);
+        p->zero = g_new0(ram_addr_t, page_count);
         p->page_count = page_count;
         p->page_size = qemu_target_page_size();
     }
@@ -1238,14 +1539,19 @@ void multifd_recv_new_channel(QIOChannel *ioc, Error **errp)
     Error *local_err = NULL;
     int id;
 
-    id = multifd_recv_initial_packet(ioc, &local_err);
-    if (id < 0) {
-        multifd_recv_terminate_threads(local_err);
-        error_propagate_prepend(errp, local_err,
-                                "failed to receive packet"
-                                " via multifd channel %d: ",
-                                qatomic_read(&multifd_recv_state->count));
-        return;
+    if (migrate_mapped_ram()) {
+        /* The file channels are opened in order and have no packets */
+        id = qatomic_read(&multifd_recv_state->count);
+    } else {
+        id = multifd_recv_initial_packet(ioc, &local_err);
+        if (id < 0) {
+            multifd_recv_terminate_threads(local_err);
+            error_propagate_prepend(errp, local_err,
+                                    "failed to receive packet"
+                                    " via multifd channel %d: ",
+                                    qatomic_read(&multifd_recv_state->count));
+            return;
+        }
     }
     trace_multifd_recv_new_channel(id);
 
@@ -1259,11 +1565,16 @@ void multifd_recv_new_channel(QIOChannel *ioc, Error **errp)
     }
     p->c = ioc;
     object_ref(OBJECT(ioc));
-    /* initial packet */
-    p->num_packets = 1;
 
     p->running = true;
-    qemu_thread_create(&p->thread, p->name, multifd_recv_thread, p,
-                       QEMU_THREAD_JOINABLE);
+    if (migrate_mapped_ram()) {
+        qemu_thread_create(&p->thread, p->name, multifd_file_recv_thread, p,
+                           QEMU_THREAD_JOINABLE);
+    } else {
+        /* initial packet */
+        p->num_packets = 1;
+        qemu_thread_create(&p->thread, p->name, multifd_recv_thread, p,
+                           QEMU_THREAD_JOINABLE);
+    }
     qatomic_inc(&multifd_recv_state->count);
 }
@@ -90,6 +90,27 @@
 #define RAM_SAVE_FLAG_MULTIFD_FLUSH    0x200
 /* We can't use any flag that is bigger than 0x200 */
 
+/*
+ * mapped-ram migration layout: each RAM block header in the stream is
+ * followed by a MappedRamHeader, then the block's page bitmap, then
+ * room for all of its pages at pages_offset, aligned so that the
+ * pages can be accessed with O_DIRECT or mmap.
+ */
+#define MAPPED_RAM_HDR_VERSION 1
+#define MAPPED_RAM_FILE_OFFSET_ALIGNMENT 0x100000
+/* Largest single read when loading a run of pages */
+#define MAPPED_RAM_LOAD_BUF_SIZE 0x100000
+
+typedef struct {
+    uint32_t version;
+    /* the target page size, which is the granularity of the bitmap */
+    uint64_t page_size;
+    /* offset in the file of the page bitmap */
+    uint64_t bitmap_offset;
+    /* offset in the file of the first page */
+    uint64_t pages_offset;
+} QEMU_PACKED MappedRamHeader;
+
 XBZRLECacheStats xbzrle_counters;
 
 /* used by the search for pages to send */
@@ -1125,7 +1146,23 @@ static int save_zero_page_to_file(PageSearchStatus *pss, QEMUFile *file,
 static int save_zero_page(PageSearchStatus *pss, QEMUFile *f, RAMBlock *block,
                           ram_addr_t offset)
 {
-    int len = save_zero_page_to_file(pss, f, block, offset);
+    int len;
+
+    if (migrate_mapped_ram()) {
+        if (!buffer_is_zero(block->host + offset, TARGET_PAGE_SIZE)) {
+            return -1;
+        }
+        /*
+         * Zero pages are not stored; drop any older copy of the page
+         * from the file so that the destination keeps its zeroed RAM.
+         * The multifd channels may be setting other bits of the word.
+         */
+        clear_bit_atomic(offset >> TARGET_PAGE_BITS, block->file_bmap);
+        stat64_add(&mig_stats.zero_pages, 1);
+        return 1;
+    }
+
+    len = save_zero_page_to_file(pss, f, block, offset);
 
     if (len) {
         stat64_add(&mig_stats.zero_pages, 1);
@@ -1189,6 +1226,15 @@ static int save_normal_page(PageSearchStatus *pss, RAMBlock *block,
 {
     QEMUFile *file = pss->pss_channel;
 
+    if (migrate_mapped_ram()) {
+        qemu_put_buffer_at(file, buf, TARGET_PAGE_SIZE,
+                           block->pages_offset + offset);
+        set_bit(offset >> TARGET_PAGE_BITS, block->file_bmap);
+        ram_transferred_add(TARGET_PAGE_SIZE);
+        stat64_add(&mig_stats.normal_pages, 1);
+        return 1;
+    }
+
     ram_transferred_add(save_page_header(pss, pss->pss_channel, block,
                                          offset | RAM_SAVE_FLAG_PAGE));
     if (async) {
@@ -1255,7 +1301,10 @@ static int ram_save_multifd_page(QEMUFile *file, RAMBlock *block,
     if (multifd_queue_page(file, block, offset) < 0) {
         return -1;
     }
-    stat64_add(&mig_stats.normal_pages, 1);
+    /* Otherwise the channel thread accounts the page once it is sorted. */
+    if (!multifd_send_zero_page_detect()) {
+        stat64_add(&mig_stats.normal_pages, 1);
+    }
 
     return 1;
 }
@@ -2090,6 +2139,13 @@ static int ram_save_target_page_legacy(RAMState *rs, PageSearchStatus *pss)
 {
     RAMBlock *block = pss->block;
     ram_addr_t offset = ((ram_addr_t)pss->page) << TARGET_PAGE_BITS;
+    /*
+     * Do not use multifd in postcopy as one whole host page should be
+     * placed.  Meanwhile postcopy requires atomic update of pages, so even
+     * if host page size == guest page size the dest guest during run may
+     * still see partially copied pages which is data corruption.
+     */
+    bool use_multifd = migrate_multifd() && !migration_in_postcopy();
     int res;
 
     if (control_save_page(pss, block, offset, &res)) {
@@ -2100,26 +2156,26 @@ static int ram_save_target_page_legacy(RAMState *rs, PageSearchStatus *pss)
         return 1;
     }
 
-    res = save_zero_page(pss, pss->pss_channel, block, offset);
-    if (res > 0) {
-        /* Must let xbzrle know, otherwise a previous (now 0'd) cached
-         * page would be stale
-         */
-        if (rs->xbzrle_started) {
-            XBZRLE_cache_lock();
-            xbzrle_cache_zero_page(rs, block->offset + offset);
-            XBZRLE_cache_unlock();
+    /*
+     * With multifd-zero-page or multifd xbzrle the channel threads look
+     * for zero pages.
+     */
+    if (!use_multifd || !multifd_send_zero_page_detect()) {
+        res = save_zero_page(pss, pss->pss_channel, block, offset);
+        if (res > 0) {
+            /* Must let xbzrle know, otherwise a previous (now 0'd) cached
+             * page would be stale
+             */
+            if (rs->xbzrle_started) {
+                XBZRLE_cache_lock();
+                xbzrle_cache_zero_page(rs, block->offset + offset);
+                XBZRLE_cache_unlock();
+            }
+            return res;
         }
-        return res;
     }
 
-    /*
-     * Do not use multifd in postcopy as one whole host page should be
-     * placed.  Meanwhile postcopy requires atomic update of pages, so even
-     * if host page size == guest page size the dest guest during run may
-     * still see partially copied pages which is data corruption.
-     */
-    if (migrate_multifd() && !migration_in_postcopy()) {
+    if (use_multifd) {
         return ram_save_multifd_page(pss->pss_channel, block, offset);
     }
 
@@ -2468,6 +2524,12 @@ static void ram_save_cleanup(void *opaque)
         block->bmap = NULL;
     }
 
+    /* Ignored blocks get a mapped-ram header and bitmap too */
+    RAMBLOCK_FOREACH_MIGRATABLE(block) {
+        g_free(block->file_bmap);
+        block->file_bmap = NULL;
+    }
+
     xbzrle_cleanup();
     compress_threads_save_cleanup();
     ram_state_cleanup(rsp);
@@ -2980,6 +3042,54 @@ void qemu_guest_free_page_hint(void *addr, size_t len)
  * granularity of these critical sections.
  */
 
+/**
+ * mapped_ram_setup_ramblock: reserve the file region of a RAM block
+ *
+ * Writes the mapped-ram header of @block at the current position of
+ * @file and moves the stream past the space for its bitmap and pages.
+ */
+static void mapped_ram_setup_ramblock(QEMUFile *file, RAMBlock *block)
+{
+    MappedRamHeader header = {};
+    size_t header_size = sizeof(header);
+    size_t bitmap_size;
+    long num_pages;
+
+    num_pages = block->used_length >> TARGET_PAGE_BITS;
+    bitmap_size = BITS_TO_LONGS(num_pages) * sizeof(unsigned long);
+
+    /*
+     * Save the file offsets of where the bitmap and the pages should
+     * go as they are written at the end of migration and during the
+     * iterative phase, respectively.
+     */
+    block->bitmap_offset = qemu_get_offset(file) + header_size;
+    block->pages_offset = ROUND_UP(block->bitmap_offset + bitmap_size,
+                                   MAPPED_RAM_FILE_OFFSET_ALIGNMENT);
+    block->file_bmap = bitmap_new(num_pages);
+
+    header.version = cpu_to_be32(MAPPED_RAM_HDR_VERSION);
+    header.page_size = cpu_to_be64(TARGET_PAGE_SIZE);
+    header.bitmap_offset = cpu_to_be64(block->bitmap_offset);
+    header.pages_offset = cpu_to_be64(block->pages_offset);
+
+    qemu_put_buffer(file, (uint8_t *)&header, header_size);
+
+    /* prepare offset for next ramblock */
+    qemu_set_offset(file, block->pages_offset + block->used_length, SEEK_SET);
+}
+
+/* Write the page bitmap of @block to its place in the migration file. */
+static void mapped_ram_save_bitmap(QEMUFile *file, RAMBlock *block)
+{
+    long num_pages = block->used_length >> TARGET_PAGE_BITS;
+    size_t bitmap_size = BITS_TO_LONGS(num_pages) * sizeof(unsigned long);
+
+    qemu_put_buffer_at(file, (uint8_t *)block->file_bmap, bitmap_size,
+                       block->bitmap_offset);
+    ram_transferred_add(bitmap_size);
+}
+
 /**
  * ram_save_setup: Setup RAM for migration
  *
@@ -3022,6 +3132,9 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
             if (migrate_ignore_shared()) {
                 qemu_put_be64(f, block->mr->addr);
             }
+            if (migrate_mapped_ram()) {
+                mapped_ram_setup_ramblock(f, block);
+            }
         }
     }
 
@@ -3187,7 +3300,12 @@ static int ram_save_complete(QEMUFile *f, void *opaque)
 
     WITH_RCU_READ_LOCK_GUARD() {
         if (!migration_in_postcopy()) {
+            int64_t start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+
             migration_bitmap_sync_precopy(rs, true);
+            migration_downtime_phase(&migrate_get_current()->downtime_stats,
+                                     MIGRATION_DOWNTIME_PHASE_BITMAP_SYNC,
+                                     start);
         }
 
         ram_control_before_iterate(f, RAM_CONTROL_FINISH);
@@ -3224,6 +3342,17 @@ static int ram_save_complete(QEMUFile *f, void *opaque)
         return ret;
     }
 
+    /* Only now have the multifd channels written every page */
+    if (migrate_mapped_ram()) {
+        RAMBlock *block;
+
+        WITH_RCU_READ_LOCK_GUARD() {
+            RAMBLOCK_FOREACH_MIGRATABLE(block) {
+                mapped_ram_save_bitmap(f, block);
+            }
+        }
+    }
+
     if (!migrate_multifd_flush_after_each_section()) {
         qemu_put_be64(f, RAM_SAVE_FLAG_MULTIFD_FLUSH);
     }
@@ -3826,6 +3955,130 @@ void colo_flush_ram_cache(void)
     trace_colo_flush_ram_cache_end();
 }
 
+/*
+ * Load the pages of @block whose bits are set in @bitmap, reading them
+ * in runs of contiguous pages from @pages_offset onwards.  With multifd
+ * the runs are read by the channel threads, in chunks of at most
+ * MAPPED_RAM_LOAD_BUF_SIZE.
+ */
+static bool read_ramblock_mapped_ram(QEMUFile *f, RAMBlock *block,
+                                     long num_pages, unsigned long *bitmap,
+                                     uint64_t pages_offset, Error **errp)
+{
+    unsigned long set_bit_idx, clear_bit_idx;
+    ram_addr_t offset;
+    void *host;
+    size_t read, unread, size;
+
+    for (set_bit_idx = find_first_bit(bitmap, num_pages);
+         set_bit_idx < num_pages;
+         set_bit_idx = find_next_bit(bitmap, num_pages, clear_bit_idx + 1)) {
+
+        clear_bit_idx = find_next_zero_bit(bitmap, num_pages, set_bit_idx + 1);
+
+        unread = TARGET_PAGE_SIZE * (clear_bit_idx - set_bit_idx);
+        offset = set_bit_idx << TARGET_PAGE_BITS;
+
+        while (unread > 0) {
+            host = host_from_ram_block_offset(block, offset);
+            if (!host) {
+                error_setg(errp, "page outside of ramblock %s range",
+                           block->idstr);
+                return false;
+            }
+
+            size = MIN(unread, MAPPED_RAM_LOAD_BUF_SIZE);
+
+            if (migrate_multifd()) {
+                if (multifd_file_recv_queue(host, size,
+                                            pages_offset + offset) < 0) {
+                    error_setg(errp, "multifd failed to read ramblock %s"
+                               " pages", block->idstr);
+                    return false;
+                }
+                read = size;
+            } else {
+                read = qemu_get_buffer_at(f, host, size,
+                                          pages_offset + offset);
+                if (!read) {
+                    error_setg(errp, "failed to read ramblock %s pages",
+                               block->idstr);
+                    return false;
+                }
+            }
+            offset += read;
+            unread -= read;
+        }
+    }
+
+    if (migrate_multifd() && multifd_file_recv_sync() < 0) {
+        error_setg(errp, "multifd failed to read ramblock %s pages",
+                   block->idstr);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Parse the mapped-ram header of @block, load its pages and move the
+ * stream past the block's region of the file.
+ */
+static int parse_ramblock_mapped_ram(QEMUFile *f, RAMBlock *block,
+                                     ram_addr_t length, Error **errp)
+{
+    g_autofree unsigned long *bitmap = NULL;
+    MappedRamHeader header;
+    size_t bitmap_size;
+    long num_pages;
+
+    if (qemu_get_buffer(f, (uint8_t *)&header, sizeof(header)) !=
+        sizeof(header)) {
+        error_setg(errp, "Could not read mapped-ram header of %s",
+                   block->idstr);
+        return -EINVAL;
+    }
+
+    header.version = be32_to_cpu(header.version);
+    if (header.version > MAPPED_RAM_HDR_VERSION) {
+        error_setg(errp, "Migration mapped-ram capability version not "
+                   "supported (expected <= %d, found %d)",
+                   MAPPED_RAM_HDR_VERSION, header.version);
+        return -EINVAL;
+    }
+
+    header.page_size = be64_to_cpu(header.page_size);
+    if (header.page_size != TARGET_PAGE_SIZE) {
+        error_setg(errp, "Mapped-ram page size mismatch for %s: "
+                   "%" PRIu64 " != %d", block->idstr, header.page_size,
+                   TARGET_PAGE_SIZE);
+        return -EINVAL;
+    }
+
+    header.bitmap_offset = be64_to_cpu(header.bitmap_offset);
+    header.pages_offset = be64_to_cpu(header.pages_offset);
+
+    num_pages = length / header.page_size;
+    bitmap_size = BITS_TO_LONGS(num_pages) * sizeof(unsigned long);
+
+    bitmap = g_malloc0(bitmap_size);
+    if (qemu_get_buffer_at(f, (uint8_t *)bitmap, bitmap_size,
+                           header.bitmap_offset) != bitmap_size) {
+        error_setg(errp, "Error reading dirty bitmap of %s", block->idstr);
+        return -EINVAL;
+    }
+
+    if (!read_ramblock_mapped_ram(f, block, num_pages, bitmap,
+                                  header.pages_offset, errp)) {
+        return -EINVAL;
+    }
+
+    /* Skip pages array */
+    qemu_set_offset(f, header.pages_offset + length, SEEK_SET);
+
+    return 0;
+}
+
 /**
  * ram_load_precopy: load pages in precopy case
  *
@@ -3967,6 +4220,15 @@ static int ram_load_precopy(QEMUFile *f)
                             ret = -EINVAL;
                         }
                     }
+                    if (!ret && migrate_mapped_ram()) {
+                        Error *local_err = NULL;
+
+                        ret = parse_ramblock_mapped_ram(f, block, length,
+                                                        &local_err);
+                        if (local_err) {
+                            error_report_err(local_err);
+                        }
+                    }
                     ram_control_load_hook(f, RAM_CONTROL_BLOCK_REG,
                                           block->idstr);
                 } else {
@@ -1415,10 +1415,14 @@ void qemu_savevm_state_complete_postcopy(QEMUFile *f)
 static
 int qemu_savevm_state_complete_precopy_iterable(QEMUFile *f, bool in_postcopy)
 {
+    MigrationState *ms = migrate_get_current();
+    int64_t phase_start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     SaveStateEntry *se;
     int ret;
 
     QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+        int64_t start;
+
         if (!se->ops ||
             (in_postcopy && se->ops->has_postcopy &&
              se->ops->has_postcopy(se->opaque)) ||
@@ -1433,6 +1437,7 @@ int qemu_savevm_state_complete_precopy_iterable(QEMUFile *f, bool in_postcopy)
         }
         trace_savevm_section_start(se->idstr, se->section_id);
 
+        start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
         save_section_header(f, se, QEMU_VM_SECTION_END);
 
         ret = se->ops->save_live_complete_precopy(f, se->opaque);
@@ -1442,8 +1447,12 @@ int qemu_savevm_state_complete_precopy_iterable(QEMUFile *f, bool in_postcopy)
             qemu_file_set_error(f, ret);
             return -1;
         }
+        migration_downtime_device(&ms->downtime_stats, se->idstr,
+                                  se->instance_id, start);
     }
 
+    migration_downtime_phase(&ms->downtime_stats,
+                             MIGRATION_DOWNTIME_PHASE_ITERABLE, phase_start);
     return 0;
 }
 
@@ -1452,22 +1461,32 @@ int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
                                                     bool inactivate_disks)
 {
     MigrationState *ms = migrate_get_current();
+    int64_t phase_start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     JSONWriter *vmdesc = ms->vmdesc;
     int vmdesc_len;
     SaveStateEntry *se;
     int ret;
 
     QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+        uint64_t written = qemu_file_transferred_fast(f);
+        int64_t start;
+
         if (se->vmsd && se->vmsd->early_setup) {
             /* Already saved during qemu_savevm_state_setup(). */
             continue;
         }
 
+        start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
         ret = vmstate_save(f, se, vmdesc);
         if (ret) {
             qemu_file_set_error(f, ret);
             return ret;
         }
+        /* Only list the sections that were not skipped */
+        if (qemu_file_transferred_fast(f) != written) {
+            migration_downtime_device(&ms->downtime_stats, se->idstr,
+                                      se->instance_id, start);
+        }
     }
 
     if (inactivate_disks) {
@@ -1500,6 +1519,9 @@ int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
     json_writer_free(vmdesc);
     ms->vmdesc = NULL;
 
+    migration_downtime_phase(&ms->downtime_stats,
+                             MIGRATION_DOWNTIME_PHASE_NON_ITERABLE,
+                             phase_start);
     return 0;
 }
 
@@ -2445,11 +2467,13 @@ static bool check_section_footer(QEMUFile *f, SaveStateEntry *se)
 }
 
 static int
-qemu_loadvm_section_start_full(QEMUFile *f, MigrationIncomingState *mis)
+qemu_loadvm_section_start_full(QEMUFile *f, MigrationIncomingState *mis,
+                               uint8_t section_type)
 {
     uint32_t instance_id, version_id, section_id;
     SaveStateEntry *se;
     char idstr[256];
+    int64_t start;
     int ret;
 
     /* Read section start */
@@ -2496,6 +2520,7 @@ qemu_loadvm_section_start_full(QEMUFile *f, MigrationIncomingState *mis)
         return -EINVAL;
     }
 
+    start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     ret = vmstate_load(f, se);
     if (ret < 0) {
         error_report("error while loading state for instance 0x%"PRIx32" of"
@@ -2505,15 +2530,22 @@ qemu_loadvm_section_start_full(QEMUFile *f, MigrationIncomingState *mis)
     if (!check_section_footer(f, se)) {
         return -EINVAL;
     }
+    if (section_type == QEMU_VM_SECTION_FULL &&
+        !(se->vmsd && se->vmsd->early_setup)) {
+        migration_downtime_device(&mis->downtime_stats, se->idstr,
+                                  se->instance_id, start);
+    }
 
     return 0;
 }
 
 static int
-qemu_loadvm_section_part_end(QEMUFile *f, MigrationIncomingState *mis)
+qemu_loadvm_section_part_end(QEMUFile *f, MigrationIncomingState *mis,
+                             uint8_t section_type)
 {
     uint32_t section_id;
     SaveStateEntry *se;
+    int64_t start;
     int ret;
 
     section_id = qemu_get_be32(f);
@@ -2536,6 +2568,7 @@ qemu_loadvm_section_part_end(QEMUFile *f, MigrationIncomingState *mis)
         return -EINVAL;
     }
 
+    start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     ret = vmstate_load(f, se);
     if (ret < 0) {
         error_report("error while loading state section id %d(%s)",
@@ -2545,6 +2578,10 @@ qemu_loadvm_section_part_end(QEMUFile *f, MigrationIncomingState *mis)
     if (!check_section_footer(f, se)) {
         return -EINVAL;
     }
+    if (section_type == QEMU_VM_SECTION_END) {
+        migration_downtime_device(&mis->downtime_stats, se->idstr,
+                                  se->instance_id, start);
+    }
 
     return 0;
 }
@@ -2712,14 +2749,14 @@ retry:
         switch (section_type) {
         case QEMU_VM_SECTION_START:
         case QEMU_VM_SECTION_FULL:
-            ret = qemu_loadvm_section_start_full(f, mis);
+            ret = qemu_loadvm_section_start_full(f, mis, section_type);
             if (ret < 0) {
                 goto out;
             }
             break;
         case QEMU_VM_SECTION_PART:
         case QEMU_VM_SECTION_END:
-            ret = qemu_loadvm_section_part_end(f, mis);
+            ret = qemu_loadvm_section_part_end(f, mis, section_type);
             if (ret < 0) {
                 goto out;
             }
@@ -2785,6 +2822,8 @@ int qemu_loadvm_state(QEMUFile *f)
         return ret;
     }
 
+    migration_downtime_reset(&mis->downtime_stats);
+
     if (qemu_loadvm_state_setup(f) != 0) {
         return -EINVAL;
     }
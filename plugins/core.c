@@ -55,6 +55,15 @@ struct qemu_plugin_ctx *plugin_id_to_ctx_locked(qemu_plugin_id_t id)
 
 static void plugin_cpu_update__async(CPUState *cpu, run_on_cpu_data data)
 {
+    /*
+     * Translated code assumes the buffer exists once the bit is set.
+     * It is kept until the vCPU exits since such code may outlive the
+     * last trace callback.
+     */
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_MEM_TRACE, &data.host_ulong) &&
+        !cpu->plugin_mem_trace) {
+        cpu->plugin_mem_trace = g_new0(struct qemu_plugin_mem_trace, 1);
+    }
     bitmap_copy(cpu->plugin_mask, &data.host_ulong, QEMU_PLUGIN_EV_MAX);
     tcg_flush_jmp_cache(cpu);
 }
@@ -210,10 +219,56 @@ plugin_register_cb_udata(qemu_plugin_id_t id, enum qemu_plugin_event ev,
     do_plugin_register_cb(id, ev, func, udata);
 }
 
+/*
+ * Make sure every scoreboard has an entry for @cpu. In system mode
+ * the number of vCPUs is bounded and the scoreboards are sized for
+ * max_cpus when the plugins are loaded. In user mode new threads can
+ * show up at any time; other vCPUs may be accessing scoreboard entries
+ * from generated code, so the arrays can only be reallocated while
+ * they are all stopped. Inline ops load the array base at run time,
+ * so no flush of the code cache is needed afterwards.
+ */
+static void plugin_grow_scoreboards(CPUState *cpu)
+{
+#ifdef CONFIG_USER_ONLY
+    struct qemu_plugin_scoreboard *score;
+    size_t new_size;
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    new_size = plugin.scoreboard_alloc_size;
+    qemu_rec_mutex_unlock(&plugin.lock);
+    if (cpu->cpu_index < new_size) {
+        return;
+    }
+
+    if (current_cpu) {
+        start_exclusive();
+    }
+    qemu_rec_mutex_lock(&plugin.lock);
+    while (cpu->cpu_index >= new_size) {
+        new_size *= 2;
+    }
+    if (new_size > plugin.scoreboard_alloc_size) {
+        QLIST_FOREACH(score, &plugin.scoreboards, entry) {
+            g_array_set_size(score->data, new_size);
+        }
+        plugin.scoreboard_alloc_size = new_size;
+    }
+    qemu_rec_mutex_unlock(&plugin.lock);
+    if (current_cpu) {
+        end_exclusive();
+    }
+#else
+    g_assert(cpu->cpu_index < plugin.scoreboard_alloc_size);
+#endif
+}
+
 void qemu_plugin_vcpu_init_hook(CPUState *cpu)
 {
     bool success;
 
+    plugin_grow_scoreboards(cpu);
+
     qemu_rec_mutex_lock(&plugin.lock);
     plugin_cpu_update__locked(&cpu->cpu_index, NULL, NULL);
     success = g_hash_table_insert(plugin.cpu_ht, &cpu->cpu_index,
@@ -228,12 +283,16 @@ void qemu_plugin_vcpu_exit_hook(CPUState *cpu)
 {
     bool success;
 
+    qemu_plugin_vcpu_mem_trace_flush(cpu);
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_EXIT);
 
     qemu_rec_mutex_lock(&plugin.lock);
     success = g_hash_table_remove(plugin.cpu_ht, &cpu->cpu_index);
     g_assert(success);
     qemu_rec_mutex_unlock(&plugin.lock);
+
+    g_free(cpu->plugin_mem_trace);
+    cpu->plugin_mem_trace = NULL;
 }
 
 struct plugin_for_each_args {
@@ -290,6 +349,25 @@ void plugin_register_inline_op(GArray **arr,
     dyn_cb->userp = ptr;
     dyn_cb->type = PLUGIN_CB_INLINE;
     dyn_cb->rw = rw;
+    dyn_cb->inline_insn.entry.score = NULL;
+    dyn_cb->inline_insn.entry.offset = 0;
+    dyn_cb->inline_insn.op = op;
+    dyn_cb->inline_insn.imm = imm;
+}
+
+void plugin_register_inline_op_on_entry(GArray **arr,
+                                        enum qemu_plugin_mem_rw rw,
+                                        enum qemu_plugin_op op,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    dyn_cb = plugin_get_dyn_cb(arr);
+    dyn_cb->userp = NULL;
+    dyn_cb->type = PLUGIN_CB_INLINE;
+    dyn_cb->rw = rw;
+    dyn_cb->inline_insn.entry = entry;
     dyn_cb->inline_insn.op = op;
     dyn_cb->inline_insn.imm = imm;
 }
@@ -307,6 +385,25 @@ void plugin_register_dyn_cb__udata(GArray **arr,
     dyn_cb->type = PLUGIN_CB_REGULAR;
 }
 
+void plugin_register_dyn_cond_cb__udata(GArray **arr,
+                                        qemu_plugin_vcpu_udata_cb_t cb,
+                                        enum qemu_plugin_cb_flags flags,
+                                        enum qemu_plugin_cond cond,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm,
+                                        void *udata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb = plugin_get_dyn_cb(arr);
+
+    dyn_cb->userp = udata;
+    /* Note flags are discarded as unused. */
+    dyn_cb->f.vcpu_udata = cb;
+    dyn_cb->type = PLUGIN_CB_REGULAR;
+    dyn_cb->cond.entry = entry;
+    dyn_cb->cond.cond = cond;
+    dyn_cb->cond.imm = imm;
+}
+
 void plugin_register_vcpu_mem_cb(GArray **arr,
                                  void *cb,
                                  enum qemu_plugin_cb_flags flags,
@@ -392,6 +489,7 @@ void qemu_plugin_vcpu_syscall_ret(CPUState *cpu, int64_t num, int64_t ret)
 
 void qemu_plugin_vcpu_idle_cb(CPUState *cpu)
 {
+    qemu_plugin_vcpu_mem_trace_flush(cpu);
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_IDLE);
 }
 
@@ -424,6 +522,31 @@ static bool free_dyn_cb_arr(void *p, uint32_t h, void *userp)
     return true;
 }
 
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
+{
+    struct qemu_plugin_scoreboard *score =
+        g_malloc0(sizeof(struct qemu_plugin_scoreboard));
+
+    qemu_rec_mutex_lock(&plugin.lock);
+    score->data = g_array_sized_new(false, true, element_size,
+                                    plugin.scoreboard_alloc_size);
+    g_array_set_size(score->data, plugin.scoreboard_alloc_size);
+    QLIST_INSERT_HEAD(&plugin.scoreboards, score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    return score;
+}
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
+{
+    qemu_rec_mutex_lock(&plugin.lock);
+    QLIST_REMOVE(score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    g_array_free(score->data, TRUE);
+    g_free(score);
+}
+
 void qemu_plugin_flush_cb(void)
 {
     qht_iter_remove(&plugin.dyn_cb_arr_ht, free_dyn_cb_arr, NULL);
@@ -432,19 +555,105 @@ void qemu_plugin_flush_cb(void)
     plugin_cb__simple(QEMU_PLUGIN_EV_FLUSH);
 }
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb)
+uint64_t *plugin_u64_address(qemu_plugin_u64 entry, unsigned int vcpu_index)
+{
+    GArray *data = entry.score->data;
+    char *base = data->data + (size_t)vcpu_index * g_array_get_element_size(data);
+
+    g_assert(vcpu_index < data->len);
+    return (uint64_t *)(base + entry.offset);
+}
+
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index)
 {
     uint64_t *val = cb->userp;
 
+    if (cb->inline_insn.entry.score) {
+        val = plugin_u64_address(cb->inline_insn.entry, cpu_index);
+    }
+
     switch (cb->inline_insn.op) {
     case QEMU_PLUGIN_INLINE_ADD_U64:
         *val += cb->inline_insn.imm;
         break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        *val = cb->inline_insn.imm;
+        break;
     default:
         g_assert_not_reached();
     }
 }
 
+/*
+ * Disable CFI checks.
+ * The callback function has been loaded from an external library so we do not
+ * have type information
+ */
+QEMU_DISABLE_CFI
+static void plugin_mem_trace_deliver(CPUState *cpu,
+                                     const struct qemu_plugin_mem_record *recs,
+                                     size_t n)
+{
+    struct qemu_plugin_cb *cb, *next;
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_MEM_TRACE;
+
+    QLIST_FOREACH_SAFE_RCU(cb, &plugin.cb_lists[ev], entry, next) {
+        qemu_plugin_vcpu_mem_trace_cb_t func = cb->f.vcpu_mem_trace;
+
+        func(cpu->cpu_index, recs, n, cb->udata);
+    }
+}
+
+/*
+ * Hand the pending records of @cpu's trace buffer to the plugins. Must
+ * be called from @cpu's thread, or while it is not running.
+ */
+void qemu_plugin_vcpu_mem_trace_flush(CPUState *cpu)
+{
+    struct qemu_plugin_mem_trace *trace = cpu->plugin_mem_trace;
+    uint32_t n, start;
+
+    if (trace == NULL || trace->head == trace->tail) {
+        return;
+    }
+
+    /*
+     * The space checks in translated code make this unlikely, but an
+     * instruction that loops internally can lap the buffer; keep the
+     * newest.
+     */
+    n = MIN(trace->head - trace->tail, PLUGIN_MEM_TRACE_ENTRIES);
+    start = (trace->head - n) % PLUGIN_MEM_TRACE_ENTRIES;
+
+    if (start + n > PLUGIN_MEM_TRACE_ENTRIES) {
+        uint32_t first = PLUGIN_MEM_TRACE_ENTRIES - start;
+
+        plugin_mem_trace_deliver(cpu, &trace->records[start], first);
+        plugin_mem_trace_deliver(cpu, &trace->records[0], n - first);
+    } else {
+        plugin_mem_trace_deliver(cpu, &trace->records[start], n);
+    }
+    trace->tail = trace->head;
+}
+
+/* Trace an access made from a helper, see plugin_gen_mem_trace_record() */
+static void plugin_mem_trace_append(CPUState *cpu, uint64_t vaddr,
+                                    qemu_plugin_meminfo_t info)
+{
+    struct qemu_plugin_mem_trace *trace = cpu->plugin_mem_trace;
+    struct qemu_plugin_mem_record *rec;
+
+    /* keep the room that translated code may have reserved */
+    if (trace->head - trace->tail >= PLUGIN_MEM_TRACE_RESERVE) {
+        qemu_plugin_vcpu_mem_trace_flush(cpu);
+    }
+    rec = &trace->records[trace->head % PLUGIN_MEM_TRACE_ENTRIES];
+    rec->vaddr = vaddr;
+    rec->pc = trace->pc;
+    rec->info = info;
+    trace->head++;
+}
+
 void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                              MemOpIdx oi, enum qemu_plugin_mem_rw rw)
 {
@@ -454,6 +663,9 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
     if (arr == NULL) {
         return;
     }
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_MEM_TRACE, cpu->plugin_mask)) {
+        plugin_mem_trace_append(cpu, vaddr, make_plugin_meminfo(oi, rw));
+    }
     for (i = 0; i < arr->len; i++) {
         struct qemu_plugin_dyn_cb *cb =
             &g_array_index(arr, struct qemu_plugin_dyn_cb, i);
@@ -467,7 +679,7 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                            vaddr, cb->userp);
             break;
         case PLUGIN_CB_INLINE:
-            exec_inline_op(cb);
+            exec_inline_op(cb, cpu->cpu_index);
             break;
         default:
             g_assert_not_reached();
@@ -477,6 +689,14 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
 
 void qemu_plugin_atexit_cb(void)
 {
+#ifndef CONFIG_USER_ONLY
+    CPUState *cpu;
+
+    /* the vCPUs are stopped by now; see qemu_plugin_user_exit for *-user */
+    CPU_FOREACH(cpu) {
+        qemu_plugin_vcpu_mem_trace_flush(cpu);
+    }
+#endif
     plugin_cb__udata(QEMU_PLUGIN_EV_ATEXIT);
 }
 
@@ -510,6 +730,11 @@ void qemu_plugin_user_exit(void)
      */
     start_exclusive();
 
+    /* deliver what is left in the trace buffers while we still can */
+    CPU_FOREACH(cpu) {
+        qemu_plugin_vcpu_mem_trace_flush(cpu);
+    }
+
     qemu_rec_mutex_lock(&plugin.lock);
     /* un-register all callbacks except the final AT_EXIT one */
     for (ev = 0; ev < QEMU_PLUGIN_EV_MAX; ev++) {
@@ -570,5 +795,7 @@ static void __attribute__((__constructor__)) plugin_init(void)
     QTAILQ_INIT(&plugin.ctxs);
     qht_init(&plugin.dyn_cb_arr_ht, plugin_dyn_cb_arr_cmp, 16,
              QHT_MODE_AUTO_RESIZE);
+    QLIST_INIT(&plugin.scoreboards);
+    plugin.scoreboard_alloc_size = 16; /* avoid frequent reallocation */
     atexit(qemu_plugin_atexit_cb);
 }
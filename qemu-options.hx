@@ -185,6 +185,7 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                one-insn-per-tb=on|off (one guest instruction per TCG translation block)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                jmp-cache-bits=n,jmp-cache-ways=1|2|4 (TCG per-vCPU jump cache geometry)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
     "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
@@ -226,6 +227,16 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``jmp-cache-bits=n``
+        Sets the number of entries in each vCPU's TCG jump cache to
+        2^n (8 to 20, default 12). Guests with a large working set of
+        code may benefit from a bigger cache; hit and miss counts are
+        reported by ``info jit``.
+
+    ``jmp-cache-ways=1|2|4``
+        Sets the associativity of the TCG jump cache. The default of 1
+        is a direct-mapped cache.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
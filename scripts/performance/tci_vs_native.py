@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+
+#  Compare the run time of a guest program under several QEMU builds,
+#  typically one with the TCG interpreter and one with native TCG.
+#  Syntax:
+#  tci_vs_native.py [-h] [-r <runs>] -b <label>=<qemu executable> \
+#           -b <label>=<qemu executable> [...] -- \
+#           [<qemu executable options>] \
+#           <target executable> [<target executable options>]
+#
+#  [-h] - Print the script arguments help message.
+#  [-r] - Number of runs per build; the fastest and the median run are
+#         reported.  If this flag is not specified, the tool defaults to 5.
+#  -b   - A build to compare, given as a label and the QEMU linux-user
+#         executable.  The first build is the baseline for the ratios.
+#
+#  Example of usage:
+#  tci_vs_native.py -b native=build/qemu-arm -b tci=build-tci/qemu-arm \
+#           -- coulomb_double-arm
+#
+#  To measure a change to the interpreter itself, e.g. the dispatch or
+#  the superinstructions, compare TCI builds from before and after it.
+#
+#  SPDX-License-Identifier: GPL-2.0-or-later
+
+import argparse
+import statistics
+import subprocess
+import sys
+import time
+
+
+# Parse the command line arguments
+parser = argparse.ArgumentParser(
+    usage='tci_vs_native.py [-h] [-r <runs>] '
+          '-b <label>=<qemu executable> -b <label>=<qemu executable> -- '
+          '[<qemu executable options>] '
+          '<target executable> [<target executable options>]')
+
+parser.add_argument('-r', dest='runs', type=int, default=5,
+                    help='Specify the number of runs per build.')
+
+parser.add_argument('-b', dest='builds', action='append', default=[],
+                    metavar='LABEL=QEMU',
+                    help='Add a QEMU build to compare.')
+
+parser.add_argument('command', type=str, nargs='+', help=argparse.SUPPRESS)
+
+args = parser.parse_args()
+
+if len(args.builds) < 2:
+    sys.exit("At least two builds are needed for a comparison!")
+if args.runs < 1:
+    sys.exit("The number of runs must be at least 1!")
+
+builds = []
+for build in args.builds:
+    label, sep, qemu = build.partition('=')
+    if not sep or not label or not qemu:
+        sys.exit("Invalid build '{}', expected <label>=<qemu executable>"
+                 .format(build))
+    builds.append((label, qemu))
+
+
+def time_run(qemu):
+    """Run the command once under qemu and return the wall clock time"""
+    start = time.perf_counter()
+    result = subprocess.run([qemu] + args.command,
+                            stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE)
+    elapsed = time.perf_counter() - start
+    if result.returncode:
+        sys.exit("{} failed with exit code {}:\n{}".format(
+            qemu, result.returncode, result.stderr.decode('utf-8')))
+    return elapsed
+
+
+# Interleave the builds so that changes in machine load affect all of them
+times = {label: [] for label, _ in builds}
+for _ in range(args.runs):
+    for label, qemu in builds:
+        times[label].append(time_run(qemu))
+
+base_label = builds[0][0]
+base_median = statistics.median(times[base_label])
+
+print("{:<16}{:>12}{:>12}{:>12}".format("Build", "Fastest", "Median",
+                                        "Ratio"))
+print("-" * 52)
+for label, _ in builds:
+    median = statistics.median(times[label])
+    print("{:<16}{:>11.3f}s{:>11.3f}s{:>11.2f}x".format(
+        label, min(times[label]), median, median / base_median))
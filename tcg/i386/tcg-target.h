@@ -205,6 +205,8 @@ typedef enum {
 #define TCG_TARGET_HAS_v64              have_avx1
 #define TCG_TARGET_HAS_v128             have_avx1
 #define TCG_TARGET_HAS_v256             have_avx2
+/* With EVEX, all byte and word operations require AVX512BW.  */
+#define TCG_TARGET_HAS_v512             have_avx512bw
 
 #define TCG_TARGET_HAS_andc_vec         1
 #define TCG_TARGET_HAS_orc_vec          have_avx512vl
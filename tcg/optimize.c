@@ -25,6 +25,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/int128.h"
+#include "qemu/interval-tree.h"
 #include "tcg/tcg-op-common.h"
 #include "tcg-internal.h"
 
@@ -37,10 +38,20 @@
         glue(glue(case INDEX_op_, x), _i64):    \
         glue(glue(case INDEX_op_, x), _vec)
 
+typedef struct MemCopyInfo {
+    IntervalTreeNode itree;
+    QSIMPLEQ_ENTRY (MemCopyInfo) next;
+    TCGTemp *ts;
+    TCGType type;
+    /* The store that wrote the value, if nothing has read it since. */
+    TCGOp *st;
+} MemCopyInfo;
+
 typedef struct TempOptInfo {
     bool is_const;
     TCGTemp *prev_copy;
     TCGTemp *next_copy;
+    QSIMPLEQ_HEAD(, MemCopyInfo) mem_copy;
     uint64_t val;
     uint64_t z_mask;  /* mask bit is 0 if and only if value bit is 0 */
     uint64_t s_mask;  /* a left-aligned mask of clrsb(value) bits. */
@@ -51,6 +62,10 @@ typedef struct OptContext {
     TCGOp *prev_mb;
     TCGTempSet temps_used;
 
+    /* Temps holding the current contents of env locations. */
+    IntervalTreeRoot mem_copy;
+    QSIMPLEQ_HEAD(, MemCopyInfo) mem_free;
+
     /* In flight values from optimization. */
     uint64_t a_mask;  /* mask bit is 0 iff value identical to first input */
     uint64_t z_mask;  /* mask bit is 0 iff value bit is 0 */
@@ -122,12 +137,65 @@ static inline bool ts_is_copy(TCGTemp *ts)
     return ts_info(ts)->next_copy != ts;
 }
 
+static inline MemCopyInfo *mem_copy_first(OptContext *ctx,
+                                          intptr_t s, intptr_t l)
+{
+    IntervalTreeNode *r = interval_tree_iter_first(&ctx->mem_copy, s, l);
+    return r ? container_of(r, MemCopyInfo, itree) : NULL;
+}
+
+static inline MemCopyInfo *mem_copy_next(MemCopyInfo *mem,
+                                         intptr_t s, intptr_t l)
+{
+    IntervalTreeNode *r = interval_tree_iter_next(&mem->itree, s, l);
+    return r ? container_of(r, MemCopyInfo, itree) : NULL;
+}
+
+static void remove_mem_copy(OptContext *ctx, MemCopyInfo *mc)
+{
+    TempOptInfo *ti = ts_info(mc->ts);
+
+    interval_tree_remove(&mc->itree, &ctx->mem_copy);
+    QSIMPLEQ_REMOVE(&ti->mem_copy, mc, MemCopyInfo, next);
+    QSIMPLEQ_INSERT_TAIL(&ctx->mem_free, mc, next);
+}
+
+/* Forget what is known about env bytes [S, L]. */
+static void remove_mem_copy_in(OptContext *ctx, intptr_t s, intptr_t l)
+{
+    MemCopyInfo *mc;
+
+    while ((mc = mem_copy_first(ctx, s, l)) != NULL) {
+        remove_mem_copy(ctx, mc);
+    }
+}
+
+static void remove_mem_copy_all(OptContext *ctx)
+{
+    remove_mem_copy_in(ctx, 0, -1);
+    tcg_debug_assert(interval_tree_is_empty(&ctx->mem_copy));
+}
+
+/*
+ * Env bytes [S, L] may be read: the stores that last wrote them
+ * can no longer be eliminated.
+ */
+static void mem_copy_read(OptContext *ctx, intptr_t s, intptr_t l)
+{
+    MemCopyInfo *mc;
+
+    for (mc = mem_copy_first(ctx, s, l); mc; mc = mem_copy_next(mc, s, l)) {
+        mc->st = NULL;
+    }
+}
+
 /* Reset TEMP's state, possibly removing the temp for the list of copies.  */
-static void reset_ts(TCGTemp *ts)
+static void reset_ts(OptContext *ctx, TCGTemp *ts)
 {
     TempOptInfo *ti = ts_info(ts);
     TempOptInfo *pi = ts_info(ti->prev_copy);
     TempOptInfo *ni = ts_info(ti->next_copy);
+    MemCopyInfo *mc;
 
     ni->prev_copy = ti->prev_copy;
     pi->next_copy = ti->next_copy;
@@ -136,11 +204,16 @@ static void reset_ts(TCGTemp *ts)
     ti->is_const = false;
     ti->z_mask = -1;
     ti->s_mask = 0;
+
+    /* The env locations copied into TS no longer match it. */
+    while ((mc = QSIMPLEQ_FIRST(&ti->mem_copy)) != NULL) {
+        remove_mem_copy(ctx, mc);
+    }
 }
 
-static void reset_temp(TCGArg arg)
+static void reset_temp(OptContext *ctx, TCGArg arg)
 {
-    reset_ts(arg_temp(arg));
+    reset_ts(ctx, arg_temp(arg));
 }
 
 /* Initialize and activate a temporary.  */
@@ -162,6 +235,7 @@ static void init_ts_info(OptContext *ctx, TCGTemp *ts)
 
     ti->next_copy = ts;
     ti->prev_copy = ts;
+    QSIMPLEQ_INIT(&ti->mem_copy);
     if (ts->kind == TEMP_CONST) {
         ti->is_const = true;
         ti->val = ts->val;
@@ -200,6 +274,46 @@ static TCGTemp *find_better_copy(TCGContext *s, TCGTemp *ts)
     return g ? g : l ? l : ts;
 }
 
+/* Note that env bytes [START, LAST] hold the value of TS. */
+static void record_mem_copy(OptContext *ctx, TCGType type, TCGTemp *ts,
+                            intptr_t start, intptr_t last, TCGOp *st)
+{
+    MemCopyInfo *mc;
+    TempOptInfo *ti;
+
+    mc = QSIMPLEQ_FIRST(&ctx->mem_free);
+    if (mc) {
+        QSIMPLEQ_REMOVE_HEAD(&ctx->mem_free, next);
+    } else {
+        mc = tcg_malloc(sizeof(*mc));
+    }
+
+    memset(mc, 0, sizeof(*mc));
+    mc->itree.start = start;
+    mc->itree.last = last;
+    mc->type = type;
+    mc->st = st;
+    interval_tree_insert(&mc->itree, &ctx->mem_copy);
+
+    ts = find_better_copy(ctx->tcg, ts);
+    ti = ts_info(ts);
+    mc->ts = ts;
+    QSIMPLEQ_INSERT_TAIL(&ti->mem_copy, mc, next);
+}
+
+static MemCopyInfo *find_mem_copy_for(OptContext *ctx, TCGType type,
+                                      intptr_t s)
+{
+    MemCopyInfo *mc;
+
+    for (mc = mem_copy_first(ctx, s, s); mc; mc = mem_copy_next(mc, s, s)) {
+        if (mc->itree.start == s && mc->type == type) {
+            return mc;
+        }
+    }
+    return NULL;
+}
+
 static bool ts_are_copies(TCGTemp *ts1, TCGTemp *ts2)
 {
     TCGTemp *i;
@@ -239,7 +353,7 @@ static bool tcg_opt_gen_mov(OptContext *ctx, TCGOp *op, TCGArg dst, TCGArg src)
         return true;
     }
 
-    reset_ts(dst_ts);
+    reset_ts(ctx, dst_ts);
     di = ts_info(dst_ts);
     si = ts_info(src_ts);
 
@@ -253,6 +367,7 @@ static bool tcg_opt_gen_mov(OptContext *ctx, TCGOp *op, TCGArg dst, TCGArg src)
     case TCG_TYPE_V64:
     case TCG_TYPE_V128:
     case TCG_TYPE_V256:
+    case TCG_TYPE_V512:
         /* TCGOP_VECL and TCGOP_VECE remain unchanged.  */
         new_op = INDEX_op_mov_vec;
         break;
@@ -692,6 +807,7 @@ static void finish_folding(OptContext *ctx, TCGOp *op)
      * We do no cross-BB optimization.
      */
     if (def->flags & TCG_OPF_BB_END) {
+        remove_mem_copy_all(ctx);
         memset(&ctx->temps_used, 0, sizeof(ctx->temps_used));
         ctx->prev_mb = NULL;
         return;
@@ -700,7 +816,7 @@ static void finish_folding(OptContext *ctx, TCGOp *op)
     nb_oargs = def->nb_oargs;
     for (i = 0; i < nb_oargs; i++) {
         TCGTemp *ts = arg_temp(op->args[i]);
-        reset_ts(ts);
+        reset_ts(ctx, ts);
         /*
          * Save the corresponding known-zero/sign bits mask for the
          * first output argument (only one supported so far).
@@ -812,6 +928,7 @@ static bool fold_to_not(OptContext *ctx, TCGOp *op, int idx)
     case TCG_TYPE_V64:
     case TCG_TYPE_V128:
     case TCG_TYPE_V256:
+    case TCG_TYPE_V512:
         not_op = INDEX_op_not_vec;
         have_not = TCG_TARGET_HAS_not_vec;
         break;
@@ -1213,14 +1330,24 @@ static bool fold_call(OptContext *ctx, TCGOp *op)
 
         for (i = 0; i < nb_globals; i++) {
             if (test_bit(i, ctx->temps_used.l)) {
-                reset_ts(&ctx->tcg->temps[i]);
+                reset_ts(ctx, &ctx->tcg->temps[i]);
             }
         }
     }
 
+    /*
+     * Any helper may read env, so the stores before it must stay.
+     * Unless it has no side effects, it may also write env.
+     */
+    if (flags & TCG_CALL_NO_SIDE_EFFECTS) {
+        mem_copy_read(ctx, 0, -1);
+    } else {
+        remove_mem_copy_all(ctx);
+    }
+
     /* Reset temp data for outputs. */
     for (i = 0; i < nb_oargs; i++) {
-        reset_temp(op->args[i]);
+        reset_temp(ctx, op->args[i]);
     }
 
     /* Stop optimizing MB across calls. */
@@ -1312,6 +1439,18 @@ static bool fold_dup(OptContext *ctx, TCGOp *op)
     return false;
 }
 
+static bool fold_dupm(OptContext *ctx, TCGOp *op)
+{
+    intptr_t ofs = op->args[2];
+
+    if (op->args[1] == tcgv_ptr_arg(cpu_env)) {
+        mem_copy_read(ctx, ofs, ofs + (1 << TCGOP_VECE(op)) - 1);
+    } else {
+        mem_copy_read(ctx, 0, -1);
+    }
+    return false;
+}
+
 static bool fold_dup2(OptContext *ctx, TCGOp *op)
 {
     if (arg_is_const(op->args[1]) && arg_is_const(op->args[2])) {
@@ -1935,6 +2074,7 @@ static bool fold_sub_to_neg(OptContext *ctx, TCGOp *op)
     case TCG_TYPE_V64:
     case TCG_TYPE_V128:
     case TCG_TYPE_V256:
+    case TCG_TYPE_V512:
         neg_op = INDEX_op_neg_vec;
         have_neg = (TCG_TARGET_HAS_neg_vec &&
                     tcg_can_emit_vec_op(neg_op, ctx->type, TCGOP_VECE(op)) > 0);
@@ -1973,32 +2113,158 @@ static bool fold_sub2(OptContext *ctx, TCGOp *op)
 
 static bool fold_tcg_ld(OptContext *ctx, TCGOp *op)
 {
+    intptr_t ofs = op->args[2];
+    intptr_t lm1;
+
     /* We can't do any folding with a load, but we can record bits. */
     switch (op->opc) {
     CASE_OP_32_64(ld8s):
         ctx->s_mask = MAKE_64BIT_MASK(8, 56);
+        lm1 = 0;
         break;
     CASE_OP_32_64(ld8u):
         ctx->z_mask = MAKE_64BIT_MASK(0, 8);
         ctx->s_mask = MAKE_64BIT_MASK(9, 55);
+        lm1 = 0;
         break;
     CASE_OP_32_64(ld16s):
         ctx->s_mask = MAKE_64BIT_MASK(16, 48);
+        lm1 = 1;
         break;
     CASE_OP_32_64(ld16u):
         ctx->z_mask = MAKE_64BIT_MASK(0, 16);
         ctx->s_mask = MAKE_64BIT_MASK(17, 47);
+        lm1 = 1;
         break;
     case INDEX_op_ld32s_i64:
         ctx->s_mask = MAKE_64BIT_MASK(32, 32);
+        lm1 = 3;
         break;
     case INDEX_op_ld32u_i64:
         ctx->z_mask = MAKE_64BIT_MASK(0, 32);
         ctx->s_mask = MAKE_64BIT_MASK(33, 31);
+        lm1 = 3;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    if (op->args[1] == tcgv_ptr_arg(cpu_env)) {
+        mem_copy_read(ctx, ofs, ofs + lm1);
+    } else {
+        mem_copy_read(ctx, 0, -1);
+    }
+    return false;
+}
+
+/*
+ * Forward the value of a full-width store to env to a later load
+ * from the same location, or remember the loaded value.
+ */
+static bool fold_tcg_ld_memcopy(OptContext *ctx, TCGOp *op)
+{
+    TCGTemp *dst;
+    MemCopyInfo *mc;
+    intptr_t ofs, last;
+    TCGType type;
+
+    if (op->args[1] != tcgv_ptr_arg(cpu_env)) {
+        mem_copy_read(ctx, 0, -1);
+        return false;
+    }
+
+    type = ctx->type;
+    ofs = op->args[2];
+    last = ofs + tcg_type_size(type) - 1;
+    dst = arg_temp(op->args[0]);
+
+    mc = find_mem_copy_for(ctx, type, ofs);
+    if (mc) {
+        TCGTemp *src = find_better_copy(ctx->tcg, mc->ts);
+
+        if (src->base_type == type) {
+            return tcg_opt_gen_mov(ctx, op, temp_arg(dst), temp_arg(src));
+        }
+    }
+
+    mem_copy_read(ctx, ofs, last);
+    reset_ts(ctx, dst);
+    record_mem_copy(ctx, type, dst, ofs, last, NULL);
+    return true;
+}
+
+static bool fold_tcg_st(OptContext *ctx, TCGOp *op)
+{
+    intptr_t ofs = op->args[2];
+    intptr_t lm1;
+
+    /* A store through any other pointer may alias env. */
+    if (op->args[1] != tcgv_ptr_arg(cpu_env)) {
+        remove_mem_copy_all(ctx);
+        return false;
+    }
+
+    switch (op->opc) {
+    CASE_OP_32_64(st8):
+        lm1 = 0;
+        break;
+    CASE_OP_32_64(st16):
+        lm1 = 1;
+        break;
+    case INDEX_op_st32_i64:
+    case INDEX_op_st_i32:
+        lm1 = 3;
+        break;
+    case INDEX_op_st_i64:
+        lm1 = 7;
+        break;
+    case INDEX_op_st_vec:
+        lm1 = tcg_type_size(ctx->type) - 1;
         break;
     default:
         g_assert_not_reached();
     }
+    remove_mem_copy_in(ctx, ofs, ofs + lm1);
+    return false;
+}
+
+/*
+ * Remember the value of a full-width store to env.  Drop the store
+ * if env already holds the value, and drop an earlier store to the
+ * same location that nothing has read since.
+ */
+static bool fold_tcg_st_memcopy(OptContext *ctx, TCGOp *op)
+{
+    TCGTemp *src;
+    MemCopyInfo *mc;
+    intptr_t ofs, last;
+    TCGType type;
+
+    if (op->args[1] != tcgv_ptr_arg(cpu_env)) {
+        return fold_tcg_st(ctx, op);
+    }
+
+    src = arg_temp(op->args[0]);
+    type = ctx->type;
+    ofs = op->args[2];
+    last = ofs + tcg_type_size(type) - 1;
+
+    mc = find_mem_copy_for(ctx, type, ofs);
+    if (mc && ts_are_copies(find_better_copy(ctx->tcg, mc->ts), src)) {
+        tcg_op_remove(ctx->tcg, op);
+        return true;
+    }
+
+    for (mc = mem_copy_first(ctx, ofs, last); mc;
+         mc = mem_copy_next(mc, ofs, last)) {
+        if (mc->st && mc->itree.start == ofs && mc->itree.last == last) {
+            tcg_op_remove(ctx->tcg, mc->st);
+            mc->st = NULL;
+        }
+    }
+
+    remove_mem_copy_in(ctx, ofs, last);
+    record_mem_copy(ctx, type, src, ofs, last, op);
     return false;
 }
 
@@ -2034,6 +2300,7 @@ void tcg_optimize(TCGContext *s)
     for (i = 0; i < nb_temps; ++i) {
         s->temps[i].state_ptr = NULL;
     }
+    QSIMPLEQ_INIT(&ctx.mem_free);
 
     QTAILQ_FOREACH_SAFE(op, &s->ops, link, op_next) {
         TCGOpcode opc = op->opc;
@@ -2059,6 +2326,14 @@ void tcg_optimize(TCGContext *s)
             ctx.type = TCG_TYPE_I32;
         }
 
+        /*
+         * Anything that may raise an exception or otherwise look at env
+         * keeps the stores before it.
+         */
+        if (def->flags & TCG_OPF_SIDE_EFFECTS) {
+            mem_copy_read(&ctx, 0, -1);
+        }
+
         /* Assume all bits affected, no bits known zero, no sign reps. */
         ctx.a_mask = -1;
         ctx.z_mask = -1;
@@ -2115,6 +2390,9 @@ void tcg_optimize(TCGContext *s)
         case INDEX_op_dup2_vec:
             done = fold_dup2(&ctx, op);
             break;
+        case INDEX_op_dupm_vec:
+            done = fold_dupm(&ctx, op);
+            break;
         CASE_OP_32_64_VEC(eqv):
             done = fold_eqv(&ctx, op);
             break;
@@ -2146,6 +2424,11 @@ void tcg_optimize(TCGContext *s)
         case INDEX_op_ld32u_i64:
             done = fold_tcg_ld(&ctx, op);
             break;
+        case INDEX_op_ld_i32:
+        case INDEX_op_ld_i64:
+        case INDEX_op_ld_vec:
+            done = fold_tcg_ld_memcopy(&ctx, op);
+            break;
         case INDEX_op_mb:
             done = fold_mb(&ctx, op);
             break;
@@ -2222,6 +2505,16 @@ void tcg_optimize(TCGContext *s)
         CASE_OP_32_64(sextract):
             done = fold_sextract(&ctx, op);
             break;
+        CASE_OP_32_64(st8):
+        CASE_OP_32_64(st16):
+        case INDEX_op_st32_i64:
+            done = fold_tcg_st(&ctx, op);
+            break;
+        case INDEX_op_st_i32:
+        case INDEX_op_st_i64:
+        case INDEX_op_st_vec:
+            done = fold_tcg_st_memcopy(&ctx, op);
+            break;
         CASE_OP_32_64(sub):
             done = fold_sub(&ctx, op);
             break;
@@ -59,7 +59,8 @@ struct tcg_region_state {
     size_t total_size; /* size of entire buffer, >= n * stride */
 
     /* fields protected by the lock */
-    size_t current; /* current region index */
+    uint64_t *seq; /* per-region allocation order; 0 if the region is free */
+    uint64_t next_seq;
     size_t agg_size_full; /* aggregate size of full regions */
 };
 
@@ -336,12 +337,16 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
 
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
-    if (region.current == region.n) {
-        return true;
+    size_t i;
+
+    for (i = 0; i < region.n; i++) {
+        if (region.seq[i] == 0) {
+            region.seq[i] = ++region.next_seq;
+            tcg_region_assign(s, i);
+            return false;
+        }
     }
-    tcg_region_assign(s, region.current);
-    region.current++;
-    return false;
+    return true;
 }
 
 /*
@@ -387,7 +392,7 @@ void tcg_region_reset_all(void)
     unsigned int i;
 
     qemu_mutex_lock(&region.lock);
-    region.current = 0;
+    memset(region.seq, 0, region.n * sizeof(*region.seq));
     region.agg_size_full = 0;
 
     for (i = 0; i < n_ctxs; i++) {
@@ -399,29 +404,99 @@ void tcg_region_reset_all(void)
     tcg_region_tree_reset_all();
 }
 
+/*
+ * Call from a safe-work context.
+ * Reclaim the oldest quarter of the regions that are not in use by any
+ * TCGContext, so that hot code translated more recently survives.
+ * @func is called on every TB of those regions before their memory is
+ * made available again; it must unlink the TB from the rest of the system.
+ * Returns the number of regions reclaimed, which is zero when there is
+ * nothing to reclaim and the caller has to fall back to a full flush.
+ */
+size_t tcg_region_reclaim(GTraverseFunc func, gpointer user_data)
+{
+    unsigned int n_ctxs = qatomic_read(&tcg_cur_ctxs);
+    size_t max = MAX(region.n / 4, 1);
+    g_autofree size_t *victims = g_new(size_t, max);
+    g_autofree bool *busy = g_new0(bool, region.n);
+    size_t n_victims = 0;
+    size_t i, j;
+
+    qemu_mutex_lock(&region.lock);
+    for (i = 0; i < n_ctxs; i++) {
+        const TCGContext *s = qatomic_read(&tcg_ctxs[i]);
+        size_t idx = ((void *)s->code_gen_buffer - region.start_aligned)
+                     / region.stride;
+
+        busy[MIN(idx, region.n - 1)] = true;
+    }
+    while (n_victims < max) {
+        size_t oldest = region.n;
+
+        for (i = 0; i < region.n; i++) {
+            if (region.seq[i] && !busy[i] &&
+                (oldest == region.n || region.seq[i] < region.seq[oldest])) {
+                oldest = i;
+            }
+        }
+        if (oldest == region.n) {
+            break;
+        }
+        busy[oldest] = true;
+        victims[n_victims++] = oldest;
+    }
+    qemu_mutex_unlock(&region.lock);
+
+    for (j = 0; j < n_victims; j++) {
+        struct tcg_region_tree *rt = region_trees + victims[j] * tree_size;
+
+        qemu_mutex_lock(&rt->lock);
+        q_tree_foreach(rt->tree, func, user_data);
+        /* Increment the refcount first so that destroy acts as a reset */
+        q_tree_ref(rt->tree);
+        q_tree_destroy(rt->tree);
+        qemu_mutex_unlock(&rt->lock);
+    }
+
+    qemu_mutex_lock(&region.lock);
+    for (j = 0; j < n_victims; j++) {
+        void *start, *end;
+
+        tcg_region_bounds(victims[j], &start, &end);
+        region.seq[victims[j]] = 0;
+        region.agg_size_full -= end - start - TCG_HIGHWATER;
+    }
+    qemu_mutex_unlock(&region.lock);
+
+    return n_victims;
+}
+
 static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
 {
+    size_t n_regions = tb_size / (2 * MiB);
+
+    /*
+     * With a single TCG context there is no contention for regions, but
+     * still use a few of them (each >= 2 MB), so that running out of
+     * space only needs to reclaim the oldest code instead of all of it.
+     */
 #ifdef CONFIG_USER_ONLY
-    return 1;
+    return MAX(MIN(n_regions, 8), 1);
 #else
-    size_t n_regions;
-
     /*
      * It is likely that some vCPUs will translate more code than others,
      * so we first try to set more regions than max_cpus, with those regions
      * being of reasonable size. If that's not possible we make do by evenly
      * dividing the code_gen_buffer among the vCPUs.
      */
-    /* Use a single region if all we have is one vCPU thread */
     if (max_cpus == 1 || !qemu_tcg_mttcg_enabled()) {
-        return 1;
+        return MAX(MIN(n_regions, 8), 1);
     }
 
     /*
      * Try to have more regions than max_cpus, with each region being >= 2 MB.
      * If we can't, then just allocate one region per vCPU thread.
      */
-    n_regions = tb_size / (2 * MiB);
     if (n_regions <= max_cpus) {
         return max_cpus;
     }
@@ -795,6 +870,7 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
 
     /* init the region struct */
     qemu_mutex_init(&region.lock);
+    region.seq = g_new0(uint64_t, region.n);
 
     /*
      * Set guard pages in the rw buffer, as that's the one into which
@@ -0,0 +1,206 @@
+/*
+ * fp-test-hardfloat.c - compare softfloat's hardfloat and soft paths
+ *
+ * The host FPU is only used once float_flag_inexact has already been
+ * raised, so each operation is run twice: once with no flags set, which
+ * always takes the soft path, and once with inexact set, which may take
+ * the hardfloat path.  Results must be identical and the flags must only
+ * differ by the inexact bit set up front.
+ *
+ * fp-test covers float16, roundToInt and the integer conversions with
+ * "-f x"; this covers the bfloat16 and min/max paths that testfloat
+ * does not implement.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#ifndef HW_POISON_H
+#error Must define HW_POISON_H to work around TARGET_* poisoning
+#endif
+
+#include "qemu/osdep.h"
+#include "fpu/softfloat.h"
+
+typedef uint64_t (*op_fn)(uint64_t a, uint64_t b, float_status *s);
+
+typedef struct {
+    int exp_bits;
+    int frac_bits;
+} fmt_desc;
+
+static const fmt_desc fmt_bf16 = { 8, 7 };
+static const fmt_desc fmt_f32 = { 8, 23 };
+static const fmt_desc fmt_f64 = { 11, 52 };
+
+typedef struct {
+    const char *name;
+    const fmt_desc *fmt;
+    op_fn fn;
+} op_desc;
+
+#define OP2(T, N)                                                       \
+    static uint64_t op_##T##_##N(uint64_t a, uint64_t b, float_status *s) \
+    {                                                                   \
+        return T##_##N(a, b, s);                                        \
+    }
+
+#define OP1(T, N)                                                       \
+    static uint64_t op_##T##_##N(uint64_t a, uint64_t b, float_status *s) \
+    {                                                                   \
+        return T##_##N(a, s);                                           \
+    }
+
+OP2(bfloat16, add)
+OP2(bfloat16, sub)
+OP2(bfloat16, mul)
+OP2(bfloat16, div)
+OP1(bfloat16, sqrt)
+
+#define OP_MINMAX(T)                            \
+    OP2(T, min)                                 \
+    OP2(T, max)                                 \
+    OP2(T, minnum)                              \
+    OP2(T, maxnum)                              \
+    OP2(T, minnummag)                           \
+    OP2(T, maxnummag)                           \
+    OP2(T, minimum_number)                      \
+    OP2(T, maximum_number)
+
+OP_MINMAX(float32)
+OP_MINMAX(float64)
+
+#define OP(T, N, F) { #T "_" #N, &F, op_##T##_##N }
+
+static const op_desc ops[] = {
+    OP(bfloat16, add, fmt_bf16),
+    OP(bfloat16, sub, fmt_bf16),
+    OP(bfloat16, mul, fmt_bf16),
+    OP(bfloat16, div, fmt_bf16),
+    OP(bfloat16, sqrt, fmt_bf16),
+    OP(float32, min, fmt_f32),
+    OP(float32, max, fmt_f32),
+    OP(float32, minnum, fmt_f32),
+    OP(float32, maxnum, fmt_f32),
+    OP(float32, minnummag, fmt_f32),
+    OP(float32, maxnummag, fmt_f32),
+    OP(float32, minimum_number, fmt_f32),
+    OP(float32, maximum_number, fmt_f32),
+    OP(float64, min, fmt_f64),
+    OP(float64, max, fmt_f64),
+    OP(float64, minnum, fmt_f64),
+    OP(float64, maxnum, fmt_f64),
+    OP(float64, minnummag, fmt_f64),
+    OP(float64, maxnummag, fmt_f64),
+    OP(float64, minimum_number, fmt_f64),
+    OP(float64, maximum_number, fmt_f64),
+};
+
+static int errors;
+
+static uint64_t rand64(void)
+{
+    return ((uint64_t)(uint32_t)mrand48() << 32) | (uint32_t)mrand48();
+}
+
+static uint64_t gen_operand(const fmt_desc *f)
+{
+    int width = 1 + f->exp_bits + f->frac_bits;
+    uint64_t sign = rand64() & (1ull << (width - 1));
+    uint64_t frac_mask = (1ull << f->frac_bits) - 1;
+    uint64_t exp_max = (1ull << f->exp_bits) - 1;
+    uint64_t bias = exp_max >> 1;
+    uint64_t exp;
+
+    switch (rand64() % 4) {
+    case 0:
+        /* zeros, denormals, min/max normals, infinities and NaNs */
+        switch (rand64() % 8) {
+        case 0:
+            return sign;
+        case 1:
+            return sign | 1;
+        case 2:
+            return sign | frac_mask;
+        case 3:
+            return sign | (1ull << f->frac_bits);
+        case 4:
+            return sign | ((exp_max - 1) << f->frac_bits) | frac_mask;
+        case 5:
+            return sign | (exp_max << f->frac_bits);
+        case 6:
+            /* quiet NaN */
+            return sign | (exp_max << f->frac_bits) |
+                   (1ull << (f->frac_bits - 1)) | (rand64() & frac_mask);
+        default:
+            /* signalling NaN */
+            return sign | (exp_max << f->frac_bits) |
+                   ((rand64() & (frac_mask >> 1)) | 1);
+        }
+    case 1:
+        /* values close to 1.0, where rounding and ties are common */
+        exp = bias - 2 + rand64() % (f->frac_bits + 4);
+        return sign | (exp << f->frac_bits) | (rand64() & frac_mask);
+    default:
+        return rand64() & ((width == 64) ? UINT64_MAX : (1ull << width) - 1);
+    }
+}
+
+static void compare(const op_desc *op, uint64_t a, uint64_t b)
+{
+    float_status soft = { 0 }, hard = { 0 };
+    uint64_t rs, rh;
+
+    set_float_rounding_mode(float_round_nearest_even, &soft);
+    set_float_rounding_mode(float_round_nearest_even, &hard);
+    hard.float_exception_flags = float_flag_inexact;
+
+    rs = op->fn(a, b, &soft);
+    rh = op->fn(a, b, &hard);
+
+    if (rs == rh &&
+        (soft.float_exception_flags | float_flag_inexact) ==
+        hard.float_exception_flags) {
+        return;
+    }
+
+    printf("%s(%016" PRIx64 ", %016" PRIx64 ")\n"
+           "  soft: %016" PRIx64 " flags %04x\n"
+           "  hard: %016" PRIx64 " flags %04x\n\n",
+           op->name, a, b,
+           rs, soft.float_exception_flags,
+           rh, hard.float_exception_flags);
+
+    if (++errors == 20) {
+        exit(1);
+    }
+}
+
+int main(int ac, char **av)
+{
+    int i, j;
+
+    for (i = 0; i < ARRAY_SIZE(ops); i++) {
+        const op_desc *op = &ops[i];
+
+        for (j = 0; j < 200000; j++) {
+            uint64_t a = gen_operand(op->fmt);
+            uint64_t b;
+
+            /* exercise equal operands and +-0 for the min/max families */
+            switch (j % 8) {
+            case 0:
+                b = a;
+                break;
+            case 1:
+                b = a ^ (1ull << (op->fmt->exp_bits + op->fmt->frac_bits));
+                break;
+            default:
+                b = gen_operand(op->fmt);
+                break;
+            }
+            compare(op, a, b);
+        }
+    }
+
+    return errors != 0;
+}
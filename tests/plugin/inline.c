@@ -0,0 +1,137 @@
+/*
+ * Cross-check the per-vCPU inline operations and conditional callbacks
+ * against the equivalent regular callbacks.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include <inttypes.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+/* call the conditional callback every SAMPLE_PERIOD executed TBs */
+#define SAMPLE_PERIOD 64
+
+typedef struct {
+    uint64_t tb_cb;
+    uint64_t tb_inline;
+    uint64_t insn_cb;
+    uint64_t insn_inline;
+    uint64_t mem_cb;
+    uint64_t mem_inline;
+    uint64_t tb_since_sample;
+    uint64_t samples;
+} CPUCount;
+
+static struct qemu_plugin_scoreboard *counts;
+static qemu_plugin_u64 tb_cb;
+static qemu_plugin_u64 tb_inline;
+static qemu_plugin_u64 insn_cb;
+static qemu_plugin_u64 insn_inline;
+static qemu_plugin_u64 mem_cb;
+static qemu_plugin_u64 mem_inline;
+static qemu_plugin_u64 tb_since_sample;
+static qemu_plugin_u64 samples;
+
+static void plugin_exit(qemu_plugin_id_t id, void *udata)
+{
+    uint64_t tb = qemu_plugin_u64_sum(tb_cb);
+    uint64_t insn = qemu_plugin_u64_sum(insn_cb);
+    uint64_t mem = qemu_plugin_u64_sum(mem_cb);
+    g_autoptr(GString) report = g_string_new("");
+
+    g_string_printf(report, "tb: %" PRIu64 ", insn: %" PRIu64
+                    ", mem: %" PRIu64 ", samples: %" PRIu64 "\n",
+                    tb, insn, mem, qemu_plugin_u64_sum(samples));
+    qemu_plugin_outs(report->str);
+
+    g_assert(tb == qemu_plugin_u64_sum(tb_inline));
+    g_assert(insn == qemu_plugin_u64_sum(insn_inline));
+    g_assert(mem == qemu_plugin_u64_sum(mem_inline));
+}
+
+static void vcpu_tb_exec(unsigned int cpu_index, void *udata)
+{
+    qemu_plugin_u64_add(tb_cb, cpu_index, 1);
+}
+
+static void vcpu_tb_sample(unsigned int cpu_index, void *udata)
+{
+    g_assert(qemu_plugin_u64_get(tb_since_sample, cpu_index) ==
+             SAMPLE_PERIOD);
+    qemu_plugin_u64_set(tb_since_sample, cpu_index, 0);
+    qemu_plugin_u64_add(samples, cpu_index, 1);
+}
+
+static void vcpu_insn_exec(unsigned int cpu_index, void *udata)
+{
+    qemu_plugin_u64_add(insn_cb, cpu_index, 1);
+}
+
+static void vcpu_mem_access(unsigned int cpu_index,
+                            qemu_plugin_meminfo_t info,
+                            uint64_t vaddr, void *udata)
+{
+    qemu_plugin_u64_add(mem_cb, cpu_index, 1);
+}
+
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    size_t n = qemu_plugin_tb_n_insns(tb);
+    size_t i;
+
+    qemu_plugin_register_vcpu_tb_exec_cb(tb, vcpu_tb_exec,
+                                         QEMU_PLUGIN_CB_NO_REGS, NULL);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, tb_inline, 1);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, tb_since_sample, 1);
+    qemu_plugin_register_vcpu_tb_exec_cond_cb(
+        tb, vcpu_tb_sample, QEMU_PLUGIN_CB_NO_REGS,
+        QEMU_PLUGIN_COND_GE, tb_since_sample, SAMPLE_PERIOD, NULL);
+
+    for (i = 0; i < n; i++) {
+        struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, i);
+
+        qemu_plugin_register_vcpu_insn_exec_cb(insn, vcpu_insn_exec,
+                                               QEMU_PLUGIN_CB_NO_REGS, NULL);
+        qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+            insn, QEMU_PLUGIN_INLINE_ADD_U64, insn_inline, 1);
+        qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem_access,
+                                         QEMU_PLUGIN_CB_NO_REGS,
+                                         QEMU_PLUGIN_MEM_RW, NULL);
+        qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+            insn, QEMU_PLUGIN_MEM_RW, QEMU_PLUGIN_INLINE_ADD_U64,
+            mem_inline, 1);
+    }
+}
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
+                                           const qemu_info_t *info,
+                                           int argc, char **argv)
+{
+    counts = qemu_plugin_scoreboard_new(sizeof(CPUCount));
+    tb_cb = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, tb_cb);
+    tb_inline = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount,
+                                                     tb_inline);
+    insn_cb = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, insn_cb);
+    insn_inline = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount,
+                                                       insn_inline);
+    mem_cb = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, mem_cb);
+    mem_inline = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount,
+                                                      mem_inline);
+    tb_since_sample = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount,
+                                                           tb_since_sample);
+    samples = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, samples);
+
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
@@ -19,7 +19,8 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
 static uint64_t inline_mem_count;
 static uint64_t cb_mem_count;
 static uint64_t io_count;
-static bool do_inline, do_callback;
+static uint64_t trace_mem_count;
+static bool do_inline, do_callback, do_trace;
 static bool do_haddr;
 static enum qemu_plugin_mem_rw rw = QEMU_PLUGIN_MEM_RW;
 
@@ -36,7 +37,16 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
     if (do_haddr) {
         g_string_append_printf(out, "io accesses: %" PRIu64 "\n", io_count);
     }
+    if (do_trace) {
+        g_string_append_printf(out, "traced mem accesses: %" PRIu64 "\n",
+                               trace_mem_count);
+    }
     qemu_plugin_outs(out->str);
+
+    /* the batched trace must see every access the callbacks saw */
+    if (do_trace && do_callback) {
+        g_assert(trace_mem_count == cb_mem_count + io_count);
+    }
 }
 
 static void vcpu_mem(unsigned int cpu_index, qemu_plugin_meminfo_t meminfo,
@@ -46,12 +56,26 @@ static void vcpu_mem(unsigned int cpu_index, qemu_plugin_meminfo_t meminfo,
         struct qemu_plugin_hwaddr *hwaddr;
         hwaddr = qemu_plugin_get_hwaddr(meminfo, vaddr);
         if (qemu_plugin_hwaddr_is_io(hwaddr)) {
-            io_count++;
+            __atomic_fetch_add(&io_count, 1, __ATOMIC_RELAXED);
         } else {
-            cb_mem_count++;
+            __atomic_fetch_add(&cb_mem_count, 1, __ATOMIC_RELAXED);
         }
     } else {
-        cb_mem_count++;
+        __atomic_fetch_add(&cb_mem_count, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void vcpu_mem_trace(unsigned int cpu_index,
+                           const struct qemu_plugin_mem_record *records,
+                           size_t n, void *udata)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (rw & (qemu_plugin_mem_is_store(records[i].info) ?
+                  QEMU_PLUGIN_MEM_W : QEMU_PLUGIN_MEM_R)) {
+            __atomic_fetch_add(&trace_mem_count, 1, __ATOMIC_RELAXED);
+        }
     }
 }
 
@@ -111,12 +135,20 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
                 fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
                 return -1;
             }
+        } else if (g_strcmp0(tokens[0], "trace") == 0) {
+            if (!qemu_plugin_bool_parse(tokens[0], tokens[1], &do_trace)) {
+                fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
+                return -1;
+            }
         } else {
             fprintf(stderr, "option parsing failed: %s\n", opt);
             return -1;
         }
     }
 
+    if (do_trace) {
+        qemu_plugin_register_vcpu_mem_trace_cb(id, vcpu_mem_trace, NULL);
+    }
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
     return 0;